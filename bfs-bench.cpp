@@ -0,0 +1,532 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <tapa.h>
+
+#include "graph.h"
+#include "graph-file.h"
+#include "graph-gen.h"
+#include "packed-graph.h"
+#include "bfs-cpu.h"
+#include "bfs-fpga.h"
+#include "bfs-validate.h"
+
+constexpr int      DEFAULT_ROOTS = 64; // Graph500 search keys per graph.
+constexpr uint64_t DEFAULT_SEED  = 1;
+
+using clock_type = std::chrono::steady_clock;
+
+static double seconds_since(clock_type::time_point start) {
+  return std::chrono::duration<double>(clock_type::now() - start).count();
+}
+
+// Graph under test. Views point into push_csr/pull_csr or the graph file.
+struct BenchGraph {
+  std::string name;
+  PushGraph   push_csr;
+  PullGraph   pull_csr;
+  GraphFile   file;
+  GraphView   push;
+  GraphView   pull;
+  double      load_time  = 0; // Read (or generate) the edges / map the file.
+  double      build_time = 0; // Build the CSR and CSC graphs.
+};
+
+// One traversal. Times are in seconds.
+struct Run {
+  nid_t    root;
+  offset_t edges;    // Edges out of the nodes reached (traversed edges).
+  double   transfer; // Invocation time outside the kernel (FPGA only).
+  double   traverse;
+  double   validate;
+  bool     valid;
+};
+
+/**
+ * Engine under test. run() fills depths (num_nodes entries, all
+ * INVALID_DEPTH on entry) for root and returns the traversal time; the time
+ * the call spent moving data is stored in transfer.
+ */
+struct Engine {
+  std::string name;
+  double      prepare_time = 0; // Engine-specific graph preparation.
+  std::function<double(nid_t root, std::vector<depth_t> &depths,
+                       double *transfer)> run;
+  // If set, runs a whole batch of roots at once (depths are row-major) and
+  // returns the time of the batch.
+  std::function<double(const nid_vec_t &roots, std::vector<depth_t> &depths)>
+    run_batch = nullptr;
+};
+
+// Splits "a,b,c".
+static std::vector<std::string> split(const std::string &list) {
+  std::vector<std::string> items;
+  std::stringstream ss(list);
+  std::string item;
+  while (std::getline(ss, item, ','))
+    if (not item.empty()) items.push_back(item);
+  return items;
+}
+
+/**
+ * Loads a graph spec: a binary graph file, a text edge list, or a
+ * synthetic graph (see parse_graph_spec).
+ * Returns false (and prints why) on error.
+ */
+static bool load_graph(const std::string &spec, uint64_t seed,
+    BenchGraph *g
+) {
+  g->name = spec;
+  auto load_start = clock_type::now();
+  edge_list_t edge_list;
+  GraphSpec graph_spec;
+  if (parse_graph_spec(spec, &graph_spec)) {
+    edge_list = generate_edges(graph_spec, seed);
+  } else if (is_graph_file(spec)) {
+    if (not g->file.open(spec)) return false;
+    g->push = g->file.push();
+    g->pull = g->file.pull();
+    g->load_time = seconds_since(load_start);
+    return true;
+  } else {
+    edge_list = load_edgelist(spec);
+  }
+  g->load_time = seconds_since(load_start);
+  if (edge_list.empty()) {
+    std::cerr << "[error] no edges loaded from " << spec << std::endl;
+    return false;
+  }
+
+  auto build_start = clock_type::now();
+  build_graphs(edge_list, &g->push_csr, &g->pull_csr);
+  g->push = g->push_csr;
+  g->pull = g->pull_csr;
+  g->build_time = seconds_since(build_start);
+  return true;
+}
+
+/**
+ * Picks num_roots distinct roots with at least one out-edge (fewer if the
+ * graph has fewer such nodes), Graph500 style.
+ */
+static nid_vec_t pick_roots(const GraphView &g, int num_roots, uint64_t seed) {
+  nid_vec_t candidates;
+  for (nid_t u = 0; u < g.num_nodes; u++)
+    if (g.index[u + 1] > g.index[u]) candidates.push_back(u);
+  std::mt19937_64 rng(seed);
+  std::shuffle(candidates.begin(), candidates.end(), rng);
+  candidates.resize(std::min<std::size_t>(candidates.size(), num_roots));
+  return candidates;
+}
+
+// Kernel time (s) reported by tapa::invoke, or the wall time if it reports
+// none. The rest of the wall time is counted as transfer.
+static double kernel_time(double kernel_ns, double wall, double *transfer) {
+  double traverse = kernel_ns > 0 ? std::min(kernel_ns * 1e-9, wall) : wall;
+  *transfer = wall - traverse;
+  return traverse;
+}
+
+/**
+ * Adds the engines named in names that can run on g to engines. Returns
+ * false (and prints why) for an unknown name.
+ *   - threads <- thread counts swept by cpu-hybrid.
+ */
+static bool make_engines(const BenchGraph &g,
+    const std::vector<std::string> &names, const std::vector<int> &threads,
+    const std::string &bitstream, std::vector<Engine> &engines
+) {
+  const GraphView push = g.push, pull = g.pull;
+  const nid_t num_nodes = push.num_nodes;
+  for (const auto &name : names) {
+    auto prepare_start = clock_type::now();
+    if (name == "cpu-push") {
+      engines.push_back({name, 0,
+        [=](nid_t root, std::vector<depth_t> &depths, double *) {
+          auto start = clock_type::now();
+          bfs_cpu_push(push, root, depths);
+          return seconds_since(start);
+        }});
+    } else if (name == "cpu-push-packed") {
+      auto packed = std::make_shared<PackedGraph>(pack_graph(push));
+      engines.push_back({name, seconds_since(prepare_start),
+        [=](nid_t root, std::vector<depth_t> &depths, double *) {
+          auto start = clock_type::now();
+          bfs_cpu_push_packed(*packed, root, depths);
+          return seconds_since(start);
+        }});
+    } else if (name == "cpu-pull") {
+      engines.push_back({name, 0,
+        [=](nid_t root, std::vector<depth_t> &depths, double *) {
+          auto start = clock_type::now();
+          bfs_cpu_pull(pull, root, depths);
+          return seconds_since(start);
+        }});
+    } else if (name == "cpu-hybrid") {
+      for (int t : threads) {
+        engines.push_back({name + "-" + std::to_string(t), 0,
+          [=](nid_t root, std::vector<depth_t> &depths, double *) {
+            auto start = clock_type::now();
+            bfs_cpu_hybrid(push, pull, root, depths, t);
+            return seconds_since(start);
+          }});
+      }
+    } else if (name == "cpu-multi-source") {
+      Engine engine{name, 0, nullptr,
+        [=](const nid_vec_t &roots, std::vector<depth_t> &depths) {
+          auto start = clock_type::now();
+          bfs_cpu_multi_source(push, roots, depths);
+          return seconds_since(start);
+        }};
+      engines.push_back(engine);
+    } else if (name == "fpga") {
+      auto level_stats = std::make_shared<std::vector<LevelStats>>(
+          num_nodes + 1);
+      auto bitmap_spill = std::make_shared<std::vector<Bitmap::tile_word_t>>(
+          Bitmap::spill_size(num_nodes));
+      auto frontier_spill = std::make_shared<nid_vec_t>(2 * num_nodes);
+      engines.push_back({name, 0,
+        [=](nid_t root, std::vector<depth_t> &depths, double *transfer) {
+          auto start = clock_type::now();
+          double kernel_ns = tapa::invoke(
+              bfs_fpga, bitstream, root, num_nodes,
+              tapa::read_only_mmap<offset_t>(push.index),
+              tapa::read_only_mmap<nid_t>(push.neighbors),
+              tapa::read_write_mmap<depth_t>(depths),
+              tapa::read_write_mmap<LevelStats>(*level_stats)
+                .reinterpret<bits<LevelStats>>(),
+              tapa::read_write_mmap<Bitmap::tile_word_t>(*bitmap_spill),
+              tapa::read_write_mmap<nid_t>(*frontier_spill));
+          return kernel_time(kernel_ns, seconds_since(start), transfer);
+        }});
+    } else if (name == "fpga-switch") {
+      auto push_index     = std::make_shared<nid_vec_t>(pad_bursts(push.index));
+      auto push_neighbors = std::make_shared<nid_vec_t>(
+          pad_bursts(push.neighbors));
+      auto pull_index     = std::make_shared<nid_vec_t>(pad_bursts(pull.index));
+      auto pull_neighbors = std::make_shared<nid_vec_t>(
+          pad_bursts(pull.neighbors));
+      auto level_stats = std::make_shared<std::vector<LevelStats>>(
+          num_nodes + 1);
+      auto bitmap_spill = std::make_shared<std::vector<Bitmap::tile_word_t>>(
+          3 * Bitmap::spill_size(num_nodes));
+      engines.push_back({name, seconds_since(prepare_start),
+        [=](nid_t root, std::vector<depth_t> &depths, double *transfer) {
+          std::fill(level_stats->begin(), level_stats->end(), LevelStats{});
+          auto start = clock_type::now();
+          double kernel_ns = tapa::invoke(
+              bfs_switch, bitstream, root, num_nodes, push.num_edges,
+              SWITCH_ALPHA, SWITCH_BETA,
+              tapa::read_only_mmap<offset_t>(*push_index)
+                .reinterpret<burst_t>(),
+              tapa::read_only_mmap<nid_t>(*push_neighbors)
+                .reinterpret<burst_t>(),
+              tapa::read_only_mmap<offset_t>(*pull_index)
+                .reinterpret<burst_t>(),
+              tapa::read_only_mmap<nid_t>(*pull_neighbors)
+                .reinterpret<burst_t>(),
+              tapa::read_only_mmap<offset_t>(push.index),
+              tapa::read_write_mmap<depth_t>(depths),
+              tapa::read_write_mmap<Bitmap::tile_word_t>(*bitmap_spill),
+              tapa::read_write_mmap<LevelStats>(*level_stats)
+                .reinterpret<bits<LevelStats>>());
+          return kernel_time(kernel_ns, seconds_since(start), transfer);
+        }});
+    } else if (name == "fpga-edge") {
+      // Same layout as the edge-centric path of bfs-host.cpp: PARTITION_NUM
+      // destination intervals of 2^interval_bits nodes, edges sharded with
+      // them.
+      int interval_bits = 0;
+      while ((nid_t(PARTITION_NUM) << interval_bits) < num_nodes)
+        interval_bits++;
+      const Vid mask = (Vid(1) << interval_bits) - 1;
+      auto shards = shard_by_destination(push, PARTITION_NUM, interval_bits);
+      auto edge_index = std::make_shared<
+        std::array<offset_vec_t, PARTITION_NUM>>();
+      auto edges = std::make_shared<std::array<nid_vec_t, PARTITION_NUM>>();
+      for (int p = 0; p < PARTITION_NUM; p++) {
+        (*edge_index)[p] = std::move(shards.first[p]);
+        (*edges)[p]      = std::move(shards.second[p]);
+        if ((*edges)[p].empty()) (*edges)[p].push_back(0);
+      }
+      auto intervals = std::make_shared<
+        std::array<std::vector<VertexAttr>, PARTITION_NUM>>();
+      auto queue = std::make_shared<std::vector<Resp>>(num_nodes);
+      auto level_stats = std::make_shared<std::vector<LevelStats>>(
+          num_nodes + 1);
+      engines.push_back({name, seconds_since(prepare_start),
+        [=](nid_t root, std::vector<depth_t> &depths, double *transfer) {
+          for (auto &interval : *intervals)
+            interval.assign(Vid(1) << interval_bits, 0xFFFFFFFF);
+          (*intervals)[root >> interval_bits][root & mask] = 0;
+          auto start = clock_type::now();
+          double kernel_ns = tapa::invoke(
+              bfs_fpga_edge, bitstream, root, interval_bits,
+              tapa::read_only_mmap<offset_t>(push.index),
+              tapa::read_only_mmaps<offset_t, PARTITION_NUM>(*edge_index),
+              tapa::read_only_mmaps<nid_t, PARTITION_NUM>(*edges),
+              tapa::read_write_mmaps<VertexAttr, PARTITION_NUM>(*intervals),
+              tapa::read_write_mmap<Resp>(*queue).reinterpret<bits<Resp>>(),
+              tapa::read_write_mmap<LevelStats>(*level_stats)
+                .reinterpret<bits<LevelStats>>());
+          double traverse =
+            kernel_time(kernel_ns, seconds_since(start), transfer);
+          for (nid_t u = 0; u < num_nodes; u++) {
+            auto depth = (*intervals)[u >> interval_bits][u & mask];
+            depths[u] = depth == 0xFFFFFFFF ? INVALID_DEPTH : depth_t(depth);
+          }
+          return traverse;
+        }});
+    } else {
+      std::cerr << "[error] unknown engine " << name << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+// Runs engine for every root and validates each traversal.
+static std::vector<Run> run_engine(const BenchGraph &g, const Engine &engine,
+    const nid_vec_t &roots
+) {
+  const nid_t num_nodes = g.push.num_nodes;
+  std::vector<Run> runs;
+  auto validate = [&](nid_t root, const depth_t *depths, Run *run) {
+    auto start = clock_type::now();
+    auto validation = validate_bfs(g.pull, root, depths);
+    run->valid = validation.num_errors == 0;
+    run->edges = validation.num_edges;
+    run->validate = seconds_since(start);
+  };
+
+  if (engine.run_batch) {
+    std::vector<depth_t> depths;
+    for (std::size_t first = 0; first < roots.size(); first += MS_BATCH) {
+      nid_vec_t batch(roots.begin() + first,
+                      roots.begin() + std::min(roots.size(), first + MS_BATCH));
+      depths.assign(batch.size() * num_nodes, INVALID_DEPTH);
+      // Every root of a batch is charged an equal share of its time.
+      double share = engine.run_batch(batch, depths) / batch.size();
+      for (std::size_t i = 0; i < batch.size(); i++) {
+        Run run = {batch[i], 0, 0, share, 0, false};
+        validate(batch[i], depths.data() + i * num_nodes, &run);
+        runs.push_back(run);
+      }
+    }
+  } else {
+    std::vector<depth_t> depths(num_nodes);
+    for (auto root : roots) {
+      std::fill(depths.begin(), depths.end(), INVALID_DEPTH);
+      Run run = {root, 0, 0, 0, 0, false};
+      run.traverse = engine.run(root, depths, &run.transfer);
+      validate(root, depths.data(), &run);
+      runs.push_back(run);
+    }
+  }
+  return runs;
+}
+
+// Mean and (sample) standard deviation.
+static std::pair<double, double> mean_stddev(const std::vector<double> &x) {
+  double mean = 0, var = 0;
+  for (auto v : x) mean += v;
+  mean /= std::max<std::size_t>(x.size(), 1);
+  for (auto v : x) var += (v - mean) * (v - mean);
+  if (x.size() > 1) var /= x.size() - 1;
+  return {mean, std::sqrt(var)};
+}
+
+/**
+ * Harmonic mean and harmonic standard deviation of TEPS, as reported by
+ * Graph500 (the standard deviation is that of the harmonic mean estimate).
+ */
+static std::pair<double, double> harmonic_teps(const std::vector<Run> &runs) {
+  std::vector<double> inverse;
+  for (const auto &run : runs)
+    if (run.edges > 0 and run.traverse > 0)
+      inverse.push_back(run.traverse / run.edges);
+  if (inverse.empty()) return {0, 0};
+  auto stats = mean_stddev(inverse);
+  double hmean = 1 / stats.first;
+  double hstddev = inverse.size() > 1
+    ? stats.second / std::sqrt(double(inverse.size())) * hmean * hmean : 0;
+  return {hmean, hstddev};
+}
+
+// Quotes s as a JSON string.
+static std::string json_string(const std::string &s) {
+  std::string quoted = "\"";
+  for (char c : s) {
+    if (c == '"' or c == '\\') {
+      quoted += '\\';
+      quoted += c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      char escape[8];
+      std::snprintf(escape, sizeof(escape), "\\u%04x", c);
+      quoted += escape;
+    } else {
+      quoted += c;
+    }
+  }
+  return quoted + '"';
+}
+
+// Writes the "name": {"mean": ..., "stddev": ...} entry of one phase.
+static void write_phase(std::ostream &out, const char *name,
+    const std::vector<Run> &runs, double Run::*phase
+) {
+  std::vector<double> x;
+  for (const auto &run : runs) x.push_back(run.*phase);
+  auto stats = mean_stddev(x);
+  out << "\"" << name << "\": {\"mean\": " << stats.first
+      << ", \"stddev\": " << stats.second << "}";
+}
+
+// Writes the JSON object of one engine on one graph.
+static void write_engine(std::ostream &out, const Engine &engine,
+    const std::vector<Run> &runs
+) {
+  auto teps = harmonic_teps(runs);
+  nid_t num_invalid = 0;
+  for (const auto &run : runs) num_invalid += not run.valid;
+  out << "        {\"engine\": " << json_string(engine.name)
+      << ", \"roots\": " << runs.size()
+      << ", \"invalid\": " << num_invalid
+      << ", \"prepare\": " << engine.prepare_time
+      << "," << std::endl << "         \"teps\": {\"harmonic_mean\": "
+      << teps.first << ", \"harmonic_stddev\": " << teps.second << "},"
+      << std::endl << "         ";
+  write_phase(out, "transfer", runs, &Run::transfer);
+  out << ", ";
+  write_phase(out, "traverse", runs, &Run::traverse);
+  out << ", ";
+  write_phase(out, "validate", runs, &Run::validate);
+  out << "}";
+}
+
+/**
+ * Benchmarks BFS engines over a set of graphs, Graph500 style: every engine
+ * runs from the same random roots of a graph, every traversal is validated
+ * (see validate_bfs), and TEPS are summarized by their harmonic mean.
+ * Usage: bfs-bench [options] <graph>...
+ *   - graph: binary graph file, text edge list, directory of either, or
+ *     <uniform|rmat|kronecker>:<scale>:<edge factor>.
+ * Options:
+ *   --roots N        <- roots per graph (default 64).
+ *   --seed S         <- seed of roots and synthetic graphs (default 1).
+ *   --engines a,b    <- engines (default: all).
+ *   --threads 1,2    <- thread counts of cpu-hybrid (default: 1 and all).
+ *   --json PATH      <- JSON report (default: bfs-bench.json).
+ * FPGA engines run the bitstream in $TAPAB, or software simulation.
+ */
+int main(int argc, char *argv[]) {
+  const std::vector<std::string> all_engines = {
+    "cpu-push", "cpu-push-packed", "cpu-pull", "cpu-hybrid",
+    "cpu-multi-source", "fpga", "fpga-switch", "fpga-edge"};
+  int num_roots = DEFAULT_ROOTS;
+  uint64_t seed = DEFAULT_SEED;
+  std::vector<std::string> engine_names = all_engines;
+  std::vector<int> threads = {1};
+  const int max_threads = std::max(1u, std::thread::hardware_concurrency());
+  if (max_threads > 1) threads.push_back(max_threads);
+  std::string json_path = "bfs-bench.json";
+  std::vector<std::string> specs;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if      (arg == "--roots" and has_value)   num_roots = atoi(argv[++i]);
+    else if (arg == "--seed" and has_value)    seed = strtoull(argv[++i],
+                                                               nullptr, 0);
+    else if (arg == "--engines" and has_value) engine_names = split(argv[++i]);
+    else if (arg == "--json" and has_value)    json_path = argv[++i];
+    else if (arg == "--threads" and has_value) {
+      threads.clear();
+      for (const auto &t : split(argv[++i])) threads.push_back(atoi(t.c_str()));
+    } else if (arg.compare(0, 2, "--") == 0) {
+      std::cerr << "[error] unknown option " << arg << std::endl;
+      return EXIT_FAILURE;
+    } else if (std::filesystem::is_directory(arg)) {
+      std::vector<std::string> files;
+      for (const auto &entry : std::filesystem::directory_iterator(arg))
+        if (entry.is_regular_file()) files.push_back(entry.path().string());
+      std::sort(files.begin(), files.end());
+      specs.insert(specs.end(), files.begin(), files.end());
+    } else {
+      specs.push_back(arg);
+    }
+  }
+  if (specs.empty() or num_roots < 1) {
+    std::cerr << "Usage: " << argv[0] << " [--roots N] [--seed S]"
+              << " [--engines a,b] [--threads 1,2] [--json PATH] <graph>..."
+              << std::endl << "Engines:";
+    for (const auto &name : all_engines) std::cerr << " " << name;
+    std::cerr << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::string bitstream;
+  if (const auto bitstream_ptr = getenv("TAPAB")) {
+    bitstream = bitstream_ptr;
+  }
+
+  std::ofstream json(json_path);
+  if (not json) {
+    std::cerr << "[error] cannot write " << json_path << std::endl;
+    return EXIT_FAILURE;
+  }
+  json << "{\"seed\": " << seed << ", \"graphs\": [" << std::endl;
+
+  bool all_valid = true;
+  for (std::size_t s = 0; s < specs.size(); s++) {
+    BenchGraph g;
+    if (not load_graph(specs[s], seed, &g)) return EXIT_FAILURE;
+    std::cout << g.name << ": " << g.push.num_nodes << " nodes, "
+              << g.push.num_edges << " edges (load " << g.load_time
+              << " s, build " << g.build_time << " s)" << std::endl;
+
+    std::vector<Engine> engines;
+    if (not make_engines(g, engine_names, threads, bitstream, engines))
+      return EXIT_FAILURE;
+    auto roots = pick_roots(g.push, num_roots, seed);
+
+    json << "    {\"graph\": " << json_string(g.name)
+         << ", \"nodes\": " << g.push.num_nodes
+         << ", \"edges\": " << g.push.num_edges
+         << ", \"load\": " << g.load_time
+         << ", \"build\": " << g.build_time
+         << ", \"engines\": [" << std::endl;
+    for (std::size_t e = 0; e < engines.size(); e++) {
+      auto runs = run_engine(g, engines[e], roots);
+      auto teps = harmonic_teps(runs);
+      nid_t num_invalid = 0;
+      for (const auto &run : runs) num_invalid += not run.valid;
+      all_valid = all_valid and num_invalid == 0;
+      std::cout << "  " << engines[e].name << ": " << teps.first / 1e6
+                << " MTEPS (+/- " << teps.second / 1e6 << ")";
+      if (num_invalid != 0)
+        std::cout << ", " << num_invalid << " invalid traversals";
+      std::cout << std::endl;
+
+      write_engine(json, engines[e], runs);
+      json << (e + 1 < engines.size() ? "," : "") << std::endl;
+    }
+    json << "    ]}" << (s + 1 < specs.size() ? "," : "") << std::endl;
+  }
+  json << "]}" << std::endl;
+  std::cout << "Report written to " << json_path << std::endl;
+  return all_valid ? EXIT_SUCCESS : EXIT_FAILURE;
+}
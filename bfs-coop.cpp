@@ -0,0 +1,117 @@
+#include "bfs-coop.h"
+
+#include <chrono>
+#include <tapa.h>
+
+#include "bfs-fpga.h"
+#include "bitmap.h"
+
+std::vector<CoopSpan> bfs_coop(const GraphView &push_g,
+    const GraphView &pull_g, nid_t start, std::vector<depth_t> &depths,
+    nid_t handoff, int alpha, int beta, const std::string &bitstream
+) {
+  const nid_t num_nodes = push_g.num_nodes;
+  auto degree = [&push_g](nid_t u) {
+    return push_g.index[u + 1] - push_g.index[u];
+  };
+
+  // Kernel inputs, prepared on first hand-off.
+  std::vector<nid_t> push_index, push_neighbors, pull_index, pull_neighbors;
+  // Explored bitmap, then frontier planes 0 and 1 (see bfs_switch_levels).
+  const std::size_t plane_bits = Bitmap::spill_size(num_nodes)
+    * Bitmap::word_bits<Bitmap::tile_word_t>::value;
+  std::vector<Bitmap::bitmap_t> bitmap_spill;
+  std::vector<LevelStats> level_stats;
+
+  std::vector<CoopSpan> spans;
+  nid_vec_t frontier = {start};
+  nid_vec_t next_frontier;
+  depths[start] = 0;
+  depth_t  depth               = 0; // Depth of the frontier.
+  nid_t    prev_frontier_nodes = 0;
+  offset_t frontier_edges      = degree(start);
+  offset_t unexplored_edges    = push_g.num_edges - frontier_edges;
+
+  while (not frontier.empty()) {
+    auto span_start = std::chrono::steady_clock::now();
+    CoopSpan span = {depth + 1, depth + 1, false, 0, 0, {}};
+
+    if (static_cast<nid_t>(frontier.size()) < handoff) { // CPU: push level.
+      next_frontier.clear();
+      frontier_edges = 0;
+      for (auto u : frontier) {
+        for (offset_t off = push_g.index[u]; off < push_g.index[u + 1];
+             off++) {
+          auto v = push_g.neighbors[off];
+          if (depths[v] == INVALID_DEPTH) {
+            depths[v] = depth + 1;
+            next_frontier.push_back(v);
+            frontier_edges += degree(v);
+          }
+        }
+      }
+      prev_frontier_nodes = frontier.size();
+      std::swap(frontier, next_frontier);
+      span.num_nodes = frontier.size();
+      depth++;
+    } else {                                             // FPGA: heavy levels.
+      if (push_index.empty()) {
+        push_index     = pad_bursts(push_g.index);
+        push_neighbors = pad_bursts(push_g.neighbors);
+        pull_index     = pad_bursts(pull_g.index);
+        pull_neighbors = pad_bursts(pull_g.neighbors);
+      }
+      bitmap_spill.assign(Bitmap::bitmap_size(3 * plane_bits), 0);
+      for (nid_t u = 0; u < num_nodes; u++)
+        if (depths[u] != INVALID_DEPTH) Bitmap::set_bit(bitmap_spill.data(), u);
+      for (auto u : frontier)
+        Bitmap::set_bit(bitmap_spill.data(), plane_bits + u);
+      level_stats.assign(num_nodes + 1, LevelStats{});
+
+      tapa::invoke(
+          bfs_switch_levels, bitstream, num_nodes, alpha, beta, handoff,
+          depth, nid_t(frontier.size()), prev_frontier_nodes,
+          frontier_edges, unexplored_edges,
+          tapa::read_only_mmap<nid_t>(push_index).reinterpret<burst_t>(),
+          tapa::read_only_mmap<nid_t>(push_neighbors).reinterpret<burst_t>(),
+          tapa::read_only_mmap<nid_t>(pull_index).reinterpret<burst_t>(),
+          tapa::read_only_mmap<nid_t>(pull_neighbors).reinterpret<burst_t>(),
+          tapa::read_only_mmap<offset_t>(push_g.index),
+          tapa::read_write_mmap<depth_t>(depths),
+          tapa::read_write_mmap<Bitmap::bitmap_t>(bitmap_spill)
+            .reinterpret<Bitmap::tile_word_t>(),
+          tapa::read_write_mmap<LevelStats>(level_stats)
+            .reinterpret<bits<LevelStats>>());
+
+      // The new frontier is the deepest level the kernel reached.
+      const depth_t first_depth = depth;
+      for (std::size_t i = 0; i < num_levels(level_stats); i++) {
+        span.modes.push_back(level_stats[i].mode);
+        depth++;
+      }
+      prev_frontier_nodes = 0;
+      frontier_edges      = 0;
+      frontier.clear();
+      for (nid_t u = 0; u < num_nodes; u++) {
+        if (depths[u] <= first_depth) continue; // Not new.
+        span.num_nodes++;
+        if (depths[u] == depth) {
+          frontier.push_back(u);
+          frontier_edges += degree(u);
+        } else {
+          unexplored_edges -= degree(u);
+          if (depths[u] == depth - 1) prev_frontier_nodes++;
+        }
+      }
+      span.on_fpga = true;
+    }
+    unexplored_edges -= frontier_edges;
+
+    std::chrono::duration<double> span_time =
+      std::chrono::steady_clock::now() - span_start;
+    span.last_depth = depth;
+    span.seconds    = span_time.count();
+    spans.push_back(span);
+  }
+  return spans;
+}
@@ -0,0 +1,39 @@
+#ifndef BFS_COOP_H
+#define BFS_COOP_H
+
+#include <string>
+#include <vector>
+
+#include "graph.h"
+
+// Levels run back to back on one side by bfs_coop.
+struct CoopSpan {
+  depth_t          first_depth; // Depth discovered by the first level.
+  depth_t          last_depth;  // Depth discovered by the last level.
+  bool             on_fpga;
+  nid_t            num_nodes;   // Nodes discovered.
+  double           seconds;
+  std::vector<int> modes;       // Mode of every level (FPGA only).
+};
+
+/**
+ * Cooperative BFS: levels whose frontier holds fewer than handoff nodes run
+ * as serial push levels on CPU, where they cost next to nothing; larger
+ * frontiers are handed to bfs_switch_levels as bitmaps, and the kernel runs
+ * until the frontier shrinks below handoff again. The kernel writes its
+ * depths straight into depths, so the CPU picks up where it stopped.
+ * Parameters:
+ *   - push_g, pull_g <- push and pull graphs.
+ *   - start          <- start node ID.
+ *   - depths         <- depths array (must all be initialized to
+ *                       INVALID_DEPTH).
+ *   - handoff        <- frontier size (nodes) at which levels move to FPGA.
+ *   - alpha, beta    <- direction-switching thresholds of the kernel.
+ *   - bitstream      <- FPGA bitstream (empty for software simulation).
+ * Returns where and how long every level ran.
+ */
+std::vector<CoopSpan> bfs_coop(const GraphView &push_g,
+    const GraphView &pull_g, nid_t start, std::vector<depth_t> &depths,
+    nid_t handoff, int alpha, int beta, const std::string &bitstream);
+
+#endif // BFS_COOP_H
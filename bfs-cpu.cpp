@@ -1,18 +1,31 @@
 #include "bfs-cpu.h"
 
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <iostream>
+#include <mutex>
 #include <queue>
+#include <thread>
+
+#include "bitmap.h"
+#include "packed-graph.h"
+#include "util.h"
 
 /**
  * Performs BFS push serially on CPU (single threaded).
  * Parameters:
- *   - G      <- push graph.
- *   - start  <- start node ID.
- *   - depths <- depths array (must all be initialized to INVALID_DEPTH).
+ *   - G       <- push graph.
+ *   - start   <- start node ID.
+ *   - depths  <- depths array (must all be initialized to INVALID_DEPTH).
+ *   - parents <- (optional) node each node was reached from (the start is
+ *                its own parent); only reached nodes are written.
  */
-void bfs_cpu_push(const PushGraph &g, nid_t start, 
-    std::vector<depth_t> &depths
+void bfs_cpu_push(const GraphView &g, nid_t start, 
+    std::vector<depth_t> &depths, nid_vec_t *parents
 ) {
   depths[start] = 0;
+  if (parents) (*parents)[start] = start;
   std::queue<nid_t> frontier;
   frontier.push(start);
 
@@ -26,6 +39,7 @@ void bfs_cpu_push(const PushGraph &g, nid_t start,
       // If unexplored, update.
       if (depths[v] == INVALID_DEPTH) {
         depths[v] = depths[u] + 1;
+        if (parents) (*parents)[v] = u;
         frontier.push(v);
       }
     }
@@ -33,36 +47,354 @@ void bfs_cpu_push(const PushGraph &g, nid_t start,
 }
 
 /**
- * Performs BFS pull serially on CPU (single threaded).
+ * Performs BFS push serially on CPU (single threaded), decoding packed
+ * neighbor lists on the fly.
  * Parameters:
- *   - G      <- pull graph.
- *   - start  <- start node ID.
- *   - depths <- depths array (must all be initialized to INVALID_DEPTH).
+ *   - G       <- packed push graph.
+ *   - start   <- start node ID.
+ *   - depths  <- depths array (must all be initialized to INVALID_DEPTH).
+ *   - parents <- (optional) as in bfs_cpu_push.
  */
-void bfs_cpu_pull(const PullGraph &g, nid_t start, 
-    std::vector<depth_t> &depths
+void bfs_cpu_push_packed(const PackedGraph &g, nid_t start, 
+    std::vector<depth_t> &depths, nid_vec_t *parents
 ) {
   depths[start] = 0;
+  if (parents) (*parents)[start] = start;
   std::queue<nid_t> frontier;
   frontier.push(start);
 
-  while (!frontier.empty()) {
-    auto n = frontier.front();
+  while (not frontier.empty()) {
+    auto u = frontier.front();
     frontier.pop();
 
-    // traverse all the nodes in the graph and update the ones whose parents is n.
-    for (nid_t u = 0; u < g.num_nodes; u++) {
-      if (depths[u] != INVALID_DEPTH) continue;
-      for (offset_t off = g.index[u]; off < g.index[u + 1]; off++) {
-        auto v = g.neighbors[off];
+    unpack_neighbors(g.words, g.index[u], g.index[u + 1], u,
+        [&](nid_t v) {
+      // If unexplored, update.
+      if (depths[v] == INVALID_DEPTH) {
+        depths[v] = depths[u] + 1;
+        if (parents) (*parents)[v] = u;
+        frontier.push(v);
+      }
+    });
+  }
+}
+
+/**
+ * Performs BFS pull serially on CPU (single threaded).
+ * Each level scans the unexplored nodes and stops at the first parent found
+ * in the current frontier bitmap (same as the PULL branch of
+ * ProcessingElement_switch).
+ * Parameters:
+ *   - G       <- pull graph.
+ *   - start   <- start node ID.
+ *   - depths  <- depths array (must all be initialized to INVALID_DEPTH).
+ *   - parents <- (optional) as in bfs_cpu_push.
+ */
+void bfs_cpu_pull(const GraphView &g, nid_t start, 
+    std::vector<depth_t> &depths, nid_vec_t *parents
+) {
+  std::vector<Bitmap::bitmap_t> frontier(Bitmap::bitmap_size(g.num_nodes));
+  std::vector<Bitmap::bitmap_t> next_frontier(frontier.size());
 
-        if (v == n) {
-          depths[u] = depths[v] + 1;
-          frontier.push(u);
+  depths[start] = 0;
+  if (parents) (*parents)[start] = start;
+  Bitmap::set_bit(frontier.data(), start);
+
+  nid_t num_updates = 1;
+  for (depth_t depth = 0; num_updates != 0; depth++) {
+    num_updates = 0;
+    for (nid_t v = 0; v < g.num_nodes; v++) {
+      if (depths[v] != INVALID_DEPTH) continue; // Already explored.
+      for (offset_t off = g.index[v]; off < g.index[v + 1]; off++) {
+        if (Bitmap::get_bit(frontier.data(), g.neighbors[off])) {
+          depths[v] = depth + 1;
+          if (parents) (*parents)[v] = g.neighbors[off];
+          Bitmap::set_bit(next_frontier.data(), v);
+          num_updates++;
           break;
         }
       }
     }
+
+    // Swap frontiers.
+    std::swap(frontier, next_frontier);
+    Bitmap::clear(next_frontier.data(), next_frontier.size());
   }
 }
 
+// Direction-optimizing thresholds (Beamer et al.).
+constexpr offset_t HYBRID_ALPHA = 15;
+constexpr nid_t    HYBRID_BETA  = 18;
+
+/**
+ * Worker threads started once per BFS and reused by every level, so small
+ * levels don't pay for thread start-up. run(n, align, fn) calls
+ * fn(tid, begin, end) over [0, n) split into num_threads contiguous ranges
+ * (boundaries are multiples of align) and returns once all ranges are
+ * done; the calling thread runs range 0.
+ */
+class WorkerPool {
+ public:
+  explicit WorkerPool(int num_threads) : num_threads_(num_threads) {
+    for (int tid = 1; tid < num_threads; tid++)
+      workers_.emplace_back([this, tid] { work(tid); });
+  }
+
+  ~WorkerPool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    start_cv_.notify_all();
+    for (auto &worker : workers_) worker.join();
+  }
+
+  void run(nid_t n, nid_t align,
+      const std::function<void(int, nid_t, nid_t)> &fn
+  ) {
+    nid_t chunk = (n + num_threads_ - 1) / num_threads_;
+    chunk = (chunk + align - 1) / align * align;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      job_     = &fn;
+      n_       = n;
+      chunk_   = chunk;
+      pending_ = num_threads_ - 1;
+      generation_++;
+    }
+    start_cv_.notify_all();
+    fn(0, 0, std::min(n, chunk));
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_cv_.wait(lock, [this] { return pending_ == 0; });
+  }
+
+ private:
+  void work(int tid) {
+    uint64_t seen = 0;
+    for (;;) {
+      const std::function<void(int, nid_t, nid_t)> *job;
+      nid_t begin, end;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        start_cv_.wait(lock, [&] { return stop_ or generation_ != seen; });
+        if (stop_) return;
+        seen  = generation_;
+        job   = job_;
+        begin = std::min<nid_t>(n_, chunk_ * tid);
+        end   = std::min<nid_t>(n_, begin + chunk_);
+      }
+      (*job)(tid, begin, end);
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending_--;
+      }
+      done_cv_.notify_one();
+    }
+  }
+
+  const int num_threads_;
+  std::vector<std::thread> workers_;
+  std::mutex               mutex_;
+  std::condition_variable  start_cv_; // New job or stop.
+  std::condition_variable  done_cv_;  // A worker finished its range.
+  const std::function<void(int, nid_t, nid_t)> *job_ = nullptr;
+  nid_t    n_          = 0;
+  nid_t    chunk_      = 0;
+  int      pending_    = 0; // Workers still running the job.
+  uint64_t generation_ = 0; // Jobs started so far.
+  bool     stop_       = false;
+};
+
+/**
+ * Performs direction-optimizing BFS on CPU (multi-threaded).
+ * Push levels expand a sparse frontier queue, pull levels scan unexplored
+ * nodes against a dense frontier bitmap. The direction is picked per level
+ * with the alpha/beta heuristic of Beamer et al.
+ * Parameters:
+ *   - push_g  <- push graph.
+ *   - pull_g  <- pull graph.
+ *   - start   <- start node ID.
+ *   - depths  <- depths array (must all be initialized to INVALID_DEPTH).
+ *   - threads <- number of worker threads (0 = hardware concurrency).
+ *   - parents <- (optional) as in bfs_cpu_push.
+ */
+void bfs_cpu_hybrid(const GraphView &push_g, const GraphView &pull_g,
+    nid_t start, std::vector<depth_t> &depths, int threads,
+    nid_vec_t *parents
+) {
+  if (threads <= 0)
+    threads = std::max(1u, std::thread::hardware_concurrency());
+
+  const nid_t num_nodes = push_g.num_nodes;
+  // Pull ranges must not share a bitmap word between threads.
+  const nid_t align = Bitmap::data_size;
+
+  std::vector<nid_t> frontier = {start};
+  std::vector<Bitmap::bitmap_t> frontier_map(Bitmap::bitmap_size(num_nodes));
+  std::vector<Bitmap::bitmap_t> next_map(Bitmap::bitmap_size(num_nodes));
+  std::vector<std::vector<nid_t>> local_frontiers(threads);
+  std::vector<offset_t> local_edges(threads);
+  std::vector<nid_t>    local_nodes(threads);
+  WorkerPool pool(threads);
+
+  depths[start] = 0;
+  if (parents) (*parents)[start] = start;
+  bool     is_push        = true;
+  nid_t    frontier_nodes = 1;
+  nid_t    prev_frontier_nodes = 0;
+  offset_t frontier_edges = push_g.index[start + 1] - push_g.index[start];
+  offset_t unexplored_edges = push_g.num_edges - frontier_edges;
+
+  for (depth_t depth = 0; frontier_nodes != 0; depth++) {
+    // Pick direction for this level.
+    bool growing = frontier_nodes > prev_frontier_nodes;
+    prev_frontier_nodes = frontier_nodes;
+    if (is_push) {
+      if (growing and frontier_edges > unexplored_edges / HYBRID_ALPHA) {
+        is_push = false;
+        Bitmap::clear(frontier_map.data(), frontier_map.size());
+        for (auto u : frontier) Bitmap::set_bit(frontier_map.data(), u);
+      }
+    } else if (not growing and frontier_nodes < num_nodes / HYBRID_BETA) {
+      is_push = true;
+      frontier.clear();
+      Bitmap::for_each(frontier_map.data(), num_nodes,
+          [&frontier](nid_t u) { frontier.push_back(u); });
+    }
+    DEBUG(std::cout << "[hybrid] depth " << depth << ": "
+                    << (is_push ? "push" : "pull") << ", " << frontier_nodes
+                    << " nodes, " << frontier_edges << " edges" << std::endl);
+
+    if (is_push) { // PUSH
+      pool.run(frontier.size(), 1,
+          [&](int tid, nid_t begin, nid_t end) {
+        auto &next = local_frontiers[tid];
+        next.clear();
+        offset_t edges = 0;
+        for (nid_t i = begin; i < end; i++) {
+          nid_t u = frontier[i];
+          for (offset_t off = push_g.index[u]; off < push_g.index[u + 1];
+               off++) {
+            nid_t v = push_g.neighbors[off];
+            depth_t expected = INVALID_DEPTH;
+            // Claim v with a CAS so only one thread enqueues it.
+            if (__atomic_load_n(&depths[v], __ATOMIC_RELAXED) == expected and
+                __atomic_compare_exchange_n(&depths[v], &expected, depth + 1,
+                  false, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+              if (parents) (*parents)[v] = u; // Only the CAS winner writes.
+              next.push_back(v);
+              edges += push_g.index[v + 1] - push_g.index[v];
+            }
+          }
+        }
+        local_edges[tid] = edges;
+      });
+
+      frontier.clear();
+      for (auto &next : local_frontiers)
+        frontier.insert(frontier.end(), next.begin(), next.end());
+      frontier_nodes = frontier.size();
+    } else { // PULL
+      Bitmap::clear(next_map.data(), next_map.size());
+      pool.run(num_nodes, align,
+          [&](int tid, nid_t begin, nid_t end) {
+        offset_t edges = 0;
+        nid_t    nodes = 0;
+        for (nid_t v = begin; v < end; v++) {
+          if (depths[v] != INVALID_DEPTH) continue;
+          for (offset_t off = pull_g.index[v]; off < pull_g.index[v + 1];
+               off++) {
+            if (Bitmap::get_bit(frontier_map.data(), pull_g.neighbors[off])) {
+              depths[v] = depth + 1;
+              if (parents) (*parents)[v] = pull_g.neighbors[off];
+              Bitmap::set_bit(next_map.data(), v);
+              edges += push_g.index[v + 1] - push_g.index[v];
+              nodes++;
+              break;
+            }
+          }
+        }
+        local_edges[tid] = edges;
+        local_nodes[tid] = nodes;
+      });
+      std::swap(frontier_map, next_map);
+
+      frontier_nodes = 0;
+      for (int tid = 0; tid < threads; tid++)
+        frontier_nodes += local_nodes[tid];
+    }
+
+    frontier_edges = 0;
+    for (int tid = 0; tid < threads; tid++) {
+      frontier_edges += local_edges[tid];
+      local_edges[tid] = local_nodes[tid] = 0;
+    }
+    unexplored_edges -= frontier_edges;
+  }
+}
+
+/**
+ * Performs one BFS per source on CPU, MS_BATCH sources at a time in a
+ * single pass each (MS-BFS, Then et al.).
+ * Every node carries a source mask: seen[v] holds the sources of the batch
+ * that reached v, visit[v] those that reached it in the last level.
+ * A frontier node's neighbor list is scanned once per level for all its
+ * sources together.
+ * Parameters:
+ *   - G       <- push graph.
+ *   - sources <- start node IDs (any number).
+ *   - depths  <- depths of source i at [i * num_nodes, (i + 1) * num_nodes)
+ *                (must all be initialized to INVALID_DEPTH).
+ */
+void bfs_cpu_multi_source(const GraphView &g, const nid_vec_t &sources,
+    std::vector<depth_t> &depths
+) {
+  const nid_t num_nodes = g.num_nodes;
+  std::vector<source_mask_t> seen(num_nodes);
+  std::vector<source_mask_t> visit(num_nodes);
+  std::vector<source_mask_t> next_visit(num_nodes);
+  nid_vec_t frontier;
+  nid_vec_t next_frontier;
+
+  for (std::size_t first = 0; first < sources.size(); first += MS_BATCH) {
+    const std::size_t batch_size =
+      std::min<std::size_t>(MS_BATCH, sources.size() - first);
+    // Source i of the batch is bit i; its depths start at row first + i.
+    depth_t *batch_depths = depths.data() + first * num_nodes;
+    std::fill(seen.begin(), seen.end(), 0);
+    std::fill(visit.begin(), visit.end(), 0);
+
+    for (std::size_t i = 0; i < batch_size; i++) {
+      nid_t u = sources[first + i];
+      if (visit[u] == 0) frontier.push_back(u);
+      seen[u]  |= source_mask_t(1) << i;
+      visit[u] |= source_mask_t(1) << i;
+      batch_depths[i * num_nodes + u] = 0;
+    }
+
+    for (depth_t depth = 1; not frontier.empty(); depth++) {
+      for (auto u : frontier) {
+        const source_mask_t mask = visit[u];
+        visit[u] = 0;
+        for (offset_t off = g.index[u]; off < g.index[u + 1]; off++) {
+          auto v = g.neighbors[off];
+          // Sources reaching v for the first time.
+          source_mask_t reached = mask & ~seen[v];
+          if (reached == 0) continue;
+          if (next_visit[v] == 0) next_frontier.push_back(v);
+          seen[v]       |= reached;
+          next_visit[v] |= reached;
+          for (; reached != 0; Bitmap::clear_lowest_bit(reached))
+            batch_depths[std::size_t(Bitmap::lowest_bit(reached)) * num_nodes
+                         + v] = depth;
+        }
+      }
+
+      // Swap frontiers.
+      std::swap(frontier, next_frontier);
+      std::swap(visit, next_visit);
+      next_frontier.clear();
+    }
+  }
+}
@@ -4,10 +4,19 @@
 #include <vector>
 
 #include "graph.h"
+#include "packed-graph.h"
 
-void bfs_cpu_push(const PushGraph &g, nid_t start, 
-    std::vector<depth_t> &depths);
-void bfs_cpu_pull(const PullGraph &g, nid_t start, 
+// Engines fill parents too if given (the BFS tree; see bfs_cpu_push).
+void bfs_cpu_push(const GraphView &g, nid_t start, 
+    std::vector<depth_t> &depths, nid_vec_t *parents = nullptr);
+void bfs_cpu_push_packed(const PackedGraph &g, nid_t start, 
+    std::vector<depth_t> &depths, nid_vec_t *parents = nullptr);
+void bfs_cpu_pull(const GraphView &g, nid_t start, 
+    std::vector<depth_t> &depths, nid_vec_t *parents = nullptr);
+void bfs_cpu_hybrid(const GraphView &push_g, const GraphView &pull_g,
+    nid_t start, std::vector<depth_t> &depths, int threads,
+    nid_vec_t *parents = nullptr);
+void bfs_cpu_multi_source(const GraphView &g, const nid_vec_t &sources,
     std::vector<depth_t> &depths);
 
 #endif // BFS_CPU_H
@@ -4,126 +4,290 @@
 #include "bfs-fpga.h"
 #include "util.h"
 
+// Depth of the task, update and response FIFOs; independent of the graph size.
+constexpr int TASK_FIFO_DEPTH = 8;
+constexpr int EDGE_FIFO_DEPTH = 64;
 
 /**
- * @details Contoller of bfs. Send out all active partitions
+ * @details Contoller of bfs. Runs one BFS level at a time: the vertices
+ *          activated by the previous level (a range of queue) are sent to
+ *          every Scatter back to back and each task_stream is closed after
+ *          the last one. Vertices reached meanwhile are appended to queue;
+ *          the level is done once every Gather PE closed its response
+ *          stream, so there is one synchronization per level. Every vertex
+ *          enters the queue once, so it needs one entry per vertex.
  * 
- * @param[in]  edges         - edges (preferrably in istream form)
- * @param[in]  vertices      - vertices, grabbed directly from DRAM. TODO: optimize it using prefetch & cache.
- * @param[out] updates       - temporary update tuples
+ * @param[in]  interval_bits - log2 of the vertices per Gather PE
+ * @param[in]  degree_index  - push index, for out-degree lookups
+ * @param[out] queue         - activated vertices and their depth (scratch)
+ * @param[out] active_q      - true before each level, false at the end
+ * @param[out] task_streams  - tasks for each Scatter, closed after each level
+ * @param[in]  resp_streams  - activated vertices (local IDs) of each Gather
+ *                             PE, closed after each level
+ * @param[out] level_stats   - LevelStats of every level (frontier_nodes
+ *                             counts vertices)
  */
-void Control(Pid num_partitions, Pid start_id, tapa::mmap<const Eid> num_edges, tapa::mmap<const Eid> edge_offsets, 
-            tapa::mmap<VertexAttr> vertices, tapa::mmap<bits<Edge>> edges, 
-            tapa::ostream<Task>& task_stream, tapa::istream<Resp>& resp_stream){
-    int num_sent = 0;// sent partitions
-    int num_done = 0;// processed partitions
-    bool all_done = false;
-    bool done[MAX_VER] = {};
-    bool active[MAX_VER] = {};
-    active[start_id] = true;
-    while(num_done!=num_sent | !all_done){
+void Control(Pid start_id, int interval_bits,
+            tapa::mmap<offset_t> degree_index,
+            tapa::mmap<bits<Resp>> queue,
+            tapa::ostreams<bool, PARTITION_NUM>& active_q,
+            tapa::ostreams<Task, PARTITION_NUM>& task_streams,
+            tapa::istreams<Resp, PARTITION_NUM>& resp_streams,
+            tapa::mmap<bits<LevelStats>> level_stats){
+    queue[0] = tapa::bit_cast<bits<Resp>>(Resp{start_id, 0});
+    Pid head = 0;// next vertex to send
+    Pid tail = 1;// next free queue entry
+    Pid level = 0;
+    for(;head!=tail;level++){
 #pragma HLS loop_tripcount max=MAX_VER
-        all_done = true;
-        //std::cout<<"num_sent "<<num_sent<<" num_done "<<num_done<<std::endl;
-        // do scatter
-        for(int i=0;i<num_partitions;i++){
+        const Pid level_start = head;
+        const Pid level_end = tail;
+        bool done[PARTITION_NUM] = {};// gathers finished with this level
+        bool sent[PARTITION_NUM] = {};// scatters that got the task at head
+        bool closed[PARTITION_NUM] = {};// scatters that got this level's EoT
+#pragma HLS array_partition variable=done complete
+#pragma HLS array_partition variable=sent complete
+#pragma HLS array_partition variable=closed complete
+        int num_done = 0;
+        uint64_t edges_sent = 0;
+        cycle_t cycles = 0;
+        for(int p=0;p<PARTITION_NUM;p++){
+#pragma HLS unroll
+            active_q[p].write(true);
+        }
+        level:
+        while(num_done<PARTITION_NUM){
 #pragma HLS loop_tripcount max=MAX_VER
-#pragma HLS pipeline
-            //std::cout<<"Processing partition "<<i<<std::endl;
-            if(!done[i] & active[i]){
-                Task t{edge_offsets[i], num_edges[i], vertices[i]};
-                task_stream.write(t);
-                //std::cout<<"Sending out "<<i<<" "<<num_edges[i]<<std::endl;
-                done[i] = true;
-                num_sent++;
-                all_done = false;
-            }           
-        }     
-        if(num_done==num_sent && all_done) break;   
-        // collect response from gather
-        TAPA_WHILE_NOT_EOT(resp_stream){
-            Resp r = resp_stream.read(nullptr);
-            active[r] = true;
-            all_done = false;            
-            //std::cout<<"Activate "<<r<<std::endl;
+#pragma HLS pipeline II=1
+            cycles++;
+            // do scatter, one vertex at a time to every Scatter; a full
+            // task_stream is retried on the next iteration
+            if(head<level_end){
+                Resp r = tapa::bit_cast<Resp>(queue[head]);
+                Eid n = degree_index[r.dst+1]-degree_index[r.dst];
+                bool all_sent = true;
+                for(int p=0;p<PARTITION_NUM;p++){
+#pragma HLS unroll
+                    // Vertices without edges need no task.
+                    if(n!=0 && !sent[p]) sent[p] = task_streams[p].try_write(Task{r.dst, r.depth});
+                    all_sent = all_sent && (n==0 || sent[p]);
+                }
+                if(all_sent){
+                    edges_sent += n;
+                    head++;
+                    for(int p=0;p<PARTITION_NUM;p++){
+#pragma HLS unroll
+                        sent[p] = false;
+                    }
+                }
+            }else{
+                // end of level; retried while a task_stream is full so the
+                // responses below keep draining
+                for(int p=0;p<PARTITION_NUM;p++){
+#pragma HLS unroll
+                    if(!closed[p]) closed[p] = task_streams[p].try_close();
+                }
+            }
+            // collect responses from gathers
+            for(int p=0;p<PARTITION_NUM;p++){
+#pragma HLS unroll
+                bool valid;
+                bool is_eot = resp_streams[p].eot(valid);
+                if(done[p] || !valid) continue;
+                if(is_eot){// level done by this gather
+                    resp_streams[p].open();
+                    done[p] = true;
+                    num_done++;
+                }else{
+                    Resp r = resp_streams[p].read(nullptr);
+                    r.dst += Vid(p) << interval_bits;// back to global ID
+                    queue[tail++] = tapa::bit_cast<bits<Resp>>(r);
+                }
+            }
         }
-        num_done++;
-        resp_stream.open();
+        level_stats[level] = tapa::bit_cast<bits<LevelStats>>(LevelStats{
+            level_end - level_start, edges_sent, tail - level_end,
+            Mode::push, cycles});
+    }
+    // end of the records (see level-stats.h)
+    level_stats[level] = tapa::bit_cast<bits<LevelStats>>(LevelStats{});
+    for(int p=0;p<PARTITION_NUM;p++){
+#pragma HLS unroll
+        active_q[p].write(false);
+    }
+    // Wait until every gather has written its interval back.
+    for(int p=0;p<PARTITION_NUM;p++){
+#pragma HLS unroll
+        resp_streams[p].open();
     }
-    task_stream.close();
 }
 /**
- * @details Scatter stage of bfs. 
+ * @details Scatter stage of bfs, one per destination interval. Streams the
+ *          edges of every task's source into this interval (local IDs) to
+ *          its Gather PE and forwards the level boundaries of Control
+ *          (active_q and the task_stream closes).
  * 
- * @param[in]  edges         - edges (preferrably in istream form)
- * @param[in]  task_stream   - information about updates to be made
- * @param[out] updates       - temporary update tuples
+ * @param[in]  task_stream   - sources to expand and their depth
+ * @param[in]  edge_index    - CSR index of this interval's edge shard
+ * @param[in]  edges         - destinations of this interval's edge shard
+ * @param[out] updates       - update tuples, closed after each level
  */
-void Scatter(tapa::mmap<bits<Edge>> edges, tapa::istream<Task>& task_stream, 
-            tapa::ostream<Update_edge_version>& updates, tapa::ostream<Update_num>& update_num_stream){
-    TAPA_WHILE_NOT_EOT(task_stream) {
-        Task t = task_stream.read();
-        //std::cout <<"Processing task: src "<<t.start_position<<", num "<<t.num_edges<<" source depth "<<t.depth<<std::endl;
-        for(int i=0;i<t.num_edges;i++){        
+void Scatter(tapa::istream<bool>& active_q, tapa::istream<Task>& task_stream,
+            tapa::mmap<offset_t> edge_index, tapa::mmap<nid_t> edges,
+            tapa::ostream<bool>& gather_active_q, tapa::ostream<Update_edge_version>& updates){
+    bool active;
+    do{
+        active = active_q.read();
+        gather_active_q.write(active);
+        if(!active) break;
+        TAPA_WHILE_NOT_EOT(task_stream){
+            Task t = task_stream.read(nullptr);
+            for(offset_t i=edge_index[t.src];i<edge_index[t.src+1];i++){
 #pragma HLS loop_tripcount max=MAX_EDGE   
-#pragma HLS pipeline
-            auto e = tapa::bit_cast<Edge>(edges[t.start_position+i]);
-            Update_edge_version u{ e.dst, t.depth+1};
-            updates.write(u);
-            //std::cout<<"Update: src "<<e.dst<<", depth "<<t.depth+1<<std::endl;
-        }    
-        //std::cout<<"Number of Update: "<<t.num_edges<<std::endl;
-        update_num_stream.write(t.num_edges);    
-    }
-    update_num_stream.close();
+#pragma HLS pipeline II=1
+                Update_edge_version u{Vid(edges[i]), t.depth+1, t.src};
+                updates.write(u);
+            }    
+        }
+        task_stream.try_open();
+        updates.close();// end of level
+    }while(active);
 }
 /**
- * @details Gather stage of bfs
+ * @details Body of the Gather PEs. Keeps the attributes of the first CACHED
+ *          vertices of its destination interval (2^interval_bits vertices)
+ *          on-chip; the rest of the interval is read and written in place
+ *          in DRAM. Reports every vertex it reaches first and closes
+ *          resp_stream once each level is done. The on-chip part is written
+ *          back to DRAM (followed by one more close) after the last level.
  * 
- * @param[in] num_vertices       - number of vertices in this partition
- * @param[in] vertex_offset      - starting vertex id of all vertices in this partition
- * @param[in] vertices           - vertices in this partition
- * @param[in] temp_updates       - temporary update tuples
- * @param[out] updates           - final update tuples
+ * @param[in]    temp_updates    - temporary update tuples, closed after each level
+ * @param[inout] vertices        - attributes of this PE's interval
+ * @param[out]   resp_stream     - activated vertices (local IDs)
+ * @param[in]    depth_of        - depth held by an attribute (unsigned)
+ * @param[in]    attr_of         - attribute written for an update
  */
-void Gather(tapa::istream<Update_edge_version>& temp_updates, tapa::istream<Update_num>& update_num_stream, 
-            tapa::mmap<VertexAttr> vertices, tapa::ostream<Resp>& resp_stream){
-    TAPA_WHILE_NOT_EOT(update_num_stream) {
-        Update_num num = update_num_stream.read(); 
-        //std::cout<<"Will proceses "<<num<<" updates"<<std::endl;
-        for(int i=0;i<num;i++){
+template <int CACHED, typename T, typename Depth, typename Attr>
+static void gather_interval(int interval_bits, tapa::istream<bool>& active_q,
+            tapa::istream<Update_edge_version>& temp_updates, 
+            tapa::mmap<T>& vertices, tapa::ostream<Resp>& resp_stream,
+            Depth depth_of, Attr attr_of){
+    const Vid num_vertices = Vid(1) << interval_bits;
+    const Vid num_cached = num_vertices < Vid(CACHED) ? num_vertices : Vid(CACHED);
+    T attrs[CACHED];
+#pragma HLS bind_storage variable=attrs type=ram_2p impl=uram
+    for(Vid v=0;v<num_cached;v++){
+#pragma HLS loop_tripcount max=CACHED
+#pragma HLS pipeline II=1
+        attrs[v] = vertices[v];
+    }
+
+    while(active_q.read()){
+#pragma HLS loop_tripcount max=MAX_VER
+        TAPA_WHILE_NOT_EOT(temp_updates){
 #pragma HLS loop_tripcount max=MAX_EDGE
-#pragma HLS pipeline
-            Update_edge_version u = temp_updates.read();
-            //std::cout <<"Processing update "<<u.dst<<", "<<u.depth<<std::endl;
-            if(vertices[u.dst]>u.depth){
-                vertices[u.dst] = u.depth;
-                Resp re = u.dst;
-                resp_stream.write(re);
-                //std::cout <<"Writing update "<<u.dst<<", "<<u.depth<<std::endl;
+#pragma HLS pipeline II=1
+            Update_edge_version u = temp_updates.read(nullptr);
+            bool cached = u.dst<num_cached;
+            T attr = cached ? attrs[u.dst] : vertices[u.dst];
+            if(depth_of(attr)>u.depth){
+                if(cached) attrs[u.dst] = attr_of(u);
+                else       vertices[u.dst] = attr_of(u);
+                resp_stream.write(Resp{u.dst, u.depth});
             }
         }
-        resp_stream.close();
+        temp_updates.try_open();
+        resp_stream.close();// end of level
     }
+
+    for(Vid v=0;v<num_cached;v++){
+#pragma HLS loop_tripcount max=CACHED
+#pragma HLS pipeline II=1
+        vertices[v] = attrs[v];
+    }
+    resp_stream.close();// interval written back
 }
 /**
- * @details Bfs with Scatter-Gather. Input partitions are expected to have the same order
- *          as specified in ThunderGP.
+ * @details Gather PE of bfs: depths only, MAX_VER of them on-chip (see
+ *          gather_interval).
  * 
- * @param[in]    num_partitions - number of partitions in a graph
- * @param[in]    num_edges      - number of edges in each partition 
- * @param[in]    edge_offsets   - start index for the starting edge in each partition
- * @param[inout] vertices       - vertices 
- * @param[in]    edges          - edges
+ * @param[inout] vertices        - depths of this PE's interval
  */
-void bfs_fpga_edge(Pid num_partitions, const Pid start_id, tapa::mmap<const Eid> num_edges, tapa::mmap<const Eid> edge_offsets, 
-                    tapa::mmap<VertexAttr> vertices, tapa::mmap<bits<Edge>> edges) {
-  tapa::stream<Task, MAX_VER> task_stream("task_stream");
-  tapa::stream<Update_edge_version, MAX_VER*MAX_EDGE> update_stream("update_stream");
-  tapa::stream<Update_num, MAX_VER> update_num_stream("update_num_stream");
-  tapa::stream<Resp, MAX_VER*MAX_EDGE> resp_stream("resp_stream");
+void Gather(int interval_bits, tapa::istream<bool>& active_q,
+            tapa::istream<Update_edge_version>& temp_updates, 
+            tapa::mmap<VertexAttr> vertices, tapa::ostream<Resp>& resp_stream){
+    gather_interval<MAX_VER>(interval_bits, active_q, temp_updates, vertices, resp_stream,
+        [](VertexAttr depth){ return depth; },
+        [](const Update_edge_version& u){ return VertexAttr(u.depth); });
+}
+/**
+ * @details Gather PE of bfs that also keeps the parents: depth and parent
+ *          packed in one tree_word_t per vertex (see pack_tree_word). The
+ *          words are twice as wide, so MAX_VER / 2 of them fit in the
+ *          on-chip buffer of Gather; the rest stay in DRAM.
+ * 
+ * @param[inout] tree            - tree words of this PE's interval
+ */
+void Gather_tree(int interval_bits, tapa::istream<bool>& active_q,
+            tapa::istream<Update_edge_version>& temp_updates, 
+            tapa::mmap<tree_word_t> tree, tapa::ostream<Resp>& resp_stream){
+    gather_interval<MAX_VER / 2>(interval_bits, active_q, temp_updates, tree, resp_stream,
+        [](tree_word_t word){ return Vid(tree_depth(word)); },
+        [](const Update_edge_version& u){ return pack_tree_word(u.depth, u.parent); });
+}
+/**
+ * @details Bfs with Scatter-Gather. Vertices are split into PARTITION_NUM
+ *          destination intervals of 2^interval_bits vertices and the edges
+ *          are sharded the same way (see shard_by_destination), so every
+ *          interval has its own Scatter feeding its own Gather PE and the
+ *          PEs run in parallel. Levels are processed one at a time, so the
+ *          first depth written is the final one, and Control synchronizes
+ *          with the PEs once per level. FIFO depths are fixed and Gather
+ *          caches at most MAX_VER vertices, so on-chip memory does not
+ *          grow with the graph.
+ * 
+ * @param[in]    interval_bits  - log2 of the vertices per Gather PE
+ * @param[in]    degree_index   - push index (out-degrees)
+ * @param[in]    edge_index     - CSR index of each interval's edge shard
+ * @param[in]    edges          - local destinations of each edge shard
+ * @param[inout] vertices       - vertex depths, one interval per Gather PE
+ * @param[out]   queue          - scratch, one entry per vertex
+ * @param[out]   level_stats    - LevelStats of every level
+ */
+void bfs_fpga_edge(const Pid start_id, int interval_bits,
+                    tapa::mmap<offset_t> degree_index,
+                    tapa::mmaps<offset_t, PARTITION_NUM> edge_index,
+                    tapa::mmaps<nid_t, PARTITION_NUM> edges,
+                    tapa::mmaps<VertexAttr, PARTITION_NUM> vertices,
+                    tapa::mmap<bits<Resp>> queue, tapa::mmap<bits<LevelStats>> level_stats) {
+  tapa::streams<bool, PARTITION_NUM, 2> active_q("active_q");
+  tapa::streams<Task, PARTITION_NUM, TASK_FIFO_DEPTH> task_streams("task_streams");
+  tapa::streams<bool, PARTITION_NUM, 2> gather_active_q("gather_active_q");
+  tapa::streams<Update_edge_version, PARTITION_NUM, EDGE_FIFO_DEPTH> gather_updates("gather_updates");
+  tapa::streams<Resp, PARTITION_NUM, EDGE_FIFO_DEPTH> resp_streams("resp_streams");
+  tapa::task()
+      .invoke(Control, start_id, interval_bits, degree_index, queue, active_q, task_streams, resp_streams, level_stats)
+      .invoke<tapa::join, PARTITION_NUM>(Scatter, active_q, task_streams, edge_index, edges, gather_active_q, gather_updates)
+      .invoke<tapa::join, PARTITION_NUM>(Gather, interval_bits, gather_active_q, gather_updates, vertices, resp_streams);
+}
+/**
+ * @details bfs_fpga_edge with the BFS tree in place of the depths (see
+ *          Gather_tree). Initialize tree to INVALID_TREE_WORD and the start
+ *          vertex to pack_tree_word(0, start_id).
+ */
+void bfs_fpga_edge_parents(const Pid start_id, int interval_bits,
+                    tapa::mmap<offset_t> degree_index,
+                    tapa::mmaps<offset_t, PARTITION_NUM> edge_index,
+                    tapa::mmaps<nid_t, PARTITION_NUM> edges,
+                    tapa::mmaps<tree_word_t, PARTITION_NUM> tree,
+                    tapa::mmap<bits<Resp>> queue, tapa::mmap<bits<LevelStats>> level_stats) {
+  tapa::streams<bool, PARTITION_NUM, 2> active_q("active_q");
+  tapa::streams<Task, PARTITION_NUM, TASK_FIFO_DEPTH> task_streams("task_streams");
+  tapa::streams<bool, PARTITION_NUM, 2> gather_active_q("gather_active_q");
+  tapa::streams<Update_edge_version, PARTITION_NUM, EDGE_FIFO_DEPTH> gather_updates("gather_updates");
+  tapa::streams<Resp, PARTITION_NUM, EDGE_FIFO_DEPTH> resp_streams("resp_streams");
   tapa::task()
-      .invoke(Control, num_partitions, start_id, num_edges, edge_offsets, vertices, edges, task_stream, resp_stream)
-      .invoke(Scatter, edges, task_stream, update_stream, update_num_stream)
-      .invoke(Gather, update_stream, update_num_stream, vertices, resp_stream);
-}
\ No newline at end of file
+      .invoke(Control, start_id, interval_bits, degree_index, queue, active_q, task_streams, resp_streams, level_stats)
+      .invoke<tapa::join, PARTITION_NUM>(Scatter, active_q, task_streams, edge_index, edges, gather_active_q, gather_updates)
+      .invoke<tapa::join, PARTITION_NUM>(Gather_tree, interval_bits, gather_active_q, gather_updates, tree, resp_streams);
+}
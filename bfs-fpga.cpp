@@ -4,73 +4,599 @@
 #include <assert.h>
 #include <iostream>
 #include "bitmap.h"
+#include "packed-graph.h"
+#include "tiled-bitmap.h"
 #include "util.h"
+#include "write-combiner.h"
 #include "limits.h"
 
-constexpr nid_t MAX_NODES = 1 << 13; // 2^{13} = 8,192
+// On-chip frontier queue entries; the rest go to frontier_spill.
+constexpr nid_t QUEUE_SIZE = 1 << 13; // 2^{13} = 8,192
+// Requested neighbor lists not processed yet (their nodes are the parents
+// of the neighbors that come back).
+constexpr nid_t MAX_PENDING = 128;
 
-void ProcessingElement(
+/**
+ * Push-only BFS over a compact frontier queue. Each epoch visits only the
+ * frontier nodes and their edges, so its cost does not depend on num_nodes.
+ * Neighbor lists are requested on req_q and arrive on nbr_q (one list per
+ * request, closed after each), so the same PE runs on plain or packed
+ * lists; requests are issued up to MAX_PENDING lists ahead of the list
+ * being processed. Discovered nodes go to update_q with their parent.
+ * The LevelStats of every epoch are written to level_stats, and the sum of
+ * their estimated cycles (pipelined loop iterations) is returned.
+ * The explored bitmap is tiled over bitmap_spill and queue entries past
+ * QUEUE_SIZE go to frontier_spill, so num_nodes is not bounded on-chip.
+ */
+static cycle_t push_query(
     nid_t num_nodes, const nid_t start_nid,
-    tapa::ostream<nid_t> &update_q,
-    tapa::mmap<offset_t> push_index, tapa::mmap<nid_t> push_neighbors
+    tapa::ostream<NodeUpdate> &update_q,
+    tapa::ostream<nid_t> &req_q, tapa::istream<nid_t> &nbr_q,
+    tapa::mmap<bits<LevelStats>> &level_stats,
+    tapa::mmap<Bitmap::tile_word_t> &bitmap_spill,
+    tapa::mmap<nid_t> &frontier_spill
 ) {
-  Bitmap::bitmap_t frontier[Bitmap::bitmap_size(MAX_NODES)];
-  Bitmap::bitmap_t next_frontier[Bitmap::bitmap_size(MAX_NODES)];
-  Bitmap::bitmap_t explored[Bitmap::bitmap_size(MAX_NODES)];
-  for (nid_t i = 0; i < Bitmap::bitmap_size(MAX_NODES); i++)
-    frontier[i] = next_frontier[i] = explored[i] = 0;
-//#pragma HLS array_partition variable=frontier complete
-//#pragma HLS array_partition variable=next_frontier complete
-//#pragma HLS array_partition variable=explored complete
+  Bitmap::TiledBitmap explored;
+  explored.reset(bitmap_spill, 0, num_nodes);
+
+  // Ping-pong frontier queues; frontier[epoch & 1] is the current one.
+  // Entry i >= QUEUE_SIZE of queue q is frontier_spill[q * num_nodes + i].
+  nid_t frontier[2][QUEUE_SIZE];
+  // Node of requested list i is pending[i % MAX_PENDING].
+  nid_t pending[MAX_PENDING];
 
   // Setup starting node.
-  Bitmap::set_bit(frontier, start_nid);
-  Bitmap::set_bit(explored, start_nid);
-  update_q.write(start_nid); // Send depth update for starting node.
+  frontier[0][0] = start_nid;
+  explored.set(bitmap_spill, start_nid);
+  update_q.write({start_nid, start_nid}); // Depth update for starting node.
   update_q.close();
 
-  nid_t num_updates;
+  nid_t   frontier_size = 1;
+  nid_t   epoch         = 0;
+  cycle_t total_cycles  = 0;
   do {
-    num_updates = 0;
+    const int cur  = epoch & 1;
+    const int next = cur ^ 1;
+    nid_t    num_updates = 0;
+    offset_t num_edges   = 0;
+    cycle_t  cycles      = 0;
 
     DEBUG(std::cout << "Next epoch" << std::endl);
 
+    nid_t num_requested = 0;
+    nid_t num_done      = 0;
     push:
-    for (nid_t u = 0; u < num_nodes; u++) {
+    while (num_done < frontier_size) {
+#pragma HLS pipeline II=1
+#pragma HLS loop_tripcount max=QUEUE_SIZE
+      cycles++;
+      // Request the next frontier node's neighbors.
+      if (num_requested < frontier_size and
+          num_requested - num_done < MAX_PENDING) {
+        nid_t i = num_requested;
+        nid_t u = i < QUEUE_SIZE ? frontier[cur][i]
+                                 : frontier_spill[cur * num_nodes + i];
+        if (req_q.try_write(u)) {
+          pending[i % MAX_PENDING] = u;
+          num_requested++;
+        }
+      }
+
+      // Process one neighbor.
+      bool valid;
+      bool is_eot = nbr_q.eot(valid);
+      if (not valid) continue;
+      if (is_eot) { // End of list.
+        nbr_q.open();
+        num_done++;
+        continue;
+      }
+      nid_t v = nbr_q.read(nullptr);
+      num_edges++;
+      if (not explored.get(bitmap_spill, v)) { // If child not explored.
+        DEBUG(std::cout << "[push] " << v << std::endl);
+        explored.set(bitmap_spill, v);
+        if (num_updates < QUEUE_SIZE)
+          frontier[next][num_updates] = v;
+        else
+          frontier_spill[next * num_nodes + num_updates] = v;
+        num_updates++;
+        update_q.write({v, pending[num_done % MAX_PENDING]});
+      }
+    }
+    update_q.close(); // Inform DepthWriter the current epoch has ended.
+
+    level_stats[epoch++] = tapa::bit_cast<bits<LevelStats>>(LevelStats{
+        uint64_t(frontier_size), uint64_t(num_edges), uint64_t(num_updates),
+        Mode::push, cycles});
+    total_cycles += cycles;
+    frontier_size = num_updates;
+  } while (frontier_size != 0);
+  // End of the records, so rows of an earlier (deeper) query don't show.
+  level_stats[epoch] = tapa::bit_cast<bits<LevelStats>>(LevelStats{});
+  return total_cycles;
+}
+
+// Runs a single push BFS (see push_query).
+void ProcessingElement(
+    nid_t num_nodes, const nid_t start_nid,
+    tapa::ostream<NodeUpdate> &update_q,
+    tapa::ostream<nid_t> &req_q, tapa::istream<nid_t> &nbr_q,
+    tapa::mmap<bits<LevelStats>> level_stats,
+    tapa::mmap<Bitmap::tile_word_t> bitmap_spill,
+    tapa::mmap<nid_t> frontier_spill
+) {
+  push_query(num_nodes, start_nid, update_q, req_q, nbr_q, level_stats,
+      bitmap_spill, frontier_spill);
+}
+
+/**
+ * Runs a push BFS (see push_query) for every start node on query_q until
+ * it is closed, so the graph stays in device memory across queries. The
+ * estimated cycles of query q go to query_cycles[q]; level_stats holds the
+ * levels of the last query.
+ */
+void SessionPE(
+    nid_t num_nodes, tapa::istream<nid_t> &query_q,
+    tapa::ostream<NodeUpdate> &update_q,
+    tapa::ostream<nid_t> &req_q, tapa::istream<nid_t> &nbr_q,
+    tapa::mmap<bits<LevelStats>> level_stats,
+    tapa::mmap<cycle_t> query_cycles,
+    tapa::mmap<Bitmap::tile_word_t> bitmap_spill,
+    tapa::mmap<nid_t> frontier_spill
+) {
+  nid_t query = 0;
+  TAPA_WHILE_NOT_EOT(query_q) {
+#pragma HLS loop_tripcount max=64
+    nid_t start_nid = query_q.read(nullptr);
+    query_cycles[query++] = push_query(num_nodes, start_nid, update_q,
+        req_q, nbr_q, level_stats, bitmap_spill, frontier_spill);
+  }
+}
+
+// Streams the start node of every session query, then closes query_q.
+void QueryReader(const nid_t num_queries, tapa::mmap<nid_t> starts,
+    tapa::ostream<nid_t> &query_q
+) {
+  for (nid_t q = 0; q < num_queries; q++) {
+#pragma HLS pipeline II=1
+    query_q.write(starts[q]);
+  }
+  query_q.close();
+}
+
+// Streams the plain CSR neighbor list of every requested node.
+void NeighborReader(tapa::istream<nid_t> &req_q, tapa::ostream<nid_t> &nbr_q,
+    tapa::mmap<offset_t> push_index, tapa::mmap<nid_t> push_neighbors
+) {
+  for (;;) {
+#pragma HLS loop_tripcount max=QUEUE_SIZE
+    nid_t u = req_q.read();
+    for (offset_t off = push_index[u]; off < push_index[u + 1]; off++) {
+#pragma HLS pipeline II=1
+      nbr_q.write(push_neighbors[off]);
+    }
+    nbr_q.close(); // End of list.
+  }
+}
+
+// Decodes the packed neighbor list (see packed-graph.h) of every requested
+// node.
+void NeighborDecoder(tapa::istream<nid_t> &req_q, tapa::ostream<nid_t> &nbr_q,
+    tapa::mmap<offset_t> packed_index, tapa::mmap<pack_word_t> packed_words
+) {
+  for (;;) {
+#pragma HLS loop_tripcount max=QUEUE_SIZE
+    nid_t u = req_q.read();
+    unpack_neighbors(packed_words, packed_index[u], packed_index[u + 1], u,
+        [&nbr_q](nid_t v) { nbr_q.write(v); });
+    nbr_q.close(); // End of list.
+  }
+}
+
+// Writes the depth of every discovered node (see write_epochs). Returns
+// after the last epoch, which discovers nothing, so it is invoked joined
+// and the kernel ends only once every depth is flushed.
+void DepthWriter(const nid_t num_nodes, tapa::istream<NodeUpdate> &update_q,
+    tapa::mmap<depth_t> depth
+) {
+  write_epochs(update_q, depth, 0, num_nodes, 0, true,
+      [](depth_t d, const NodeUpdate &) { return d; }, [] {});
+}
+
+// DepthWriter that also keeps the parents: one packed word per node (see
+// pack_tree_word), written as a single depth would be.
+void TreeWriter(const nid_t num_nodes, tapa::istream<NodeUpdate> &update_q,
+    tapa::mmap<tree_word_t> tree
+) {
+  write_epochs(update_q, tree, 0, num_nodes, 0, true,
+      [](depth_t d, const NodeUpdate &update) {
+        return pack_tree_word(d, update.parent);
+      }, [] {});
+}
+
+/**
+ * DepthWriter for num_queries session queries: query q's depths start at
+ * depth[q * num_nodes]. Every epoch but the last of a query has at least
+ * one update, so an empty epoch ends the query.
+ */
+void SessionDepthWriter(const nid_t num_queries, const nid_t num_nodes,
+    tapa::istream<NodeUpdate> &update_q, tapa::mmap<depth_t> depth
+) {
+  uint64_t base = 0;
+  for (nid_t q = 0; q < num_queries; q++, base += num_nodes) {
+#pragma HLS loop_tripcount max=64
+    write_epochs(update_q, depth, base, base + num_nodes, 0, true,
+        [](depth_t d, const NodeUpdate &) { return d; }, [] {});
+  }
+}
+
+void bfs_fpga(
+    const nid_t start_nid, const nid_t num_nodes, 
+    tapa::mmap<offset_t> push_index, tapa::mmap<nid_t> push_neighbors,
+    tapa::mmap<depth_t> depths, tapa::mmap<bits<LevelStats>> level_stats,
+    tapa::mmap<Bitmap::tile_word_t> bitmap_spill,
+    tapa::mmap<nid_t> frontier_spill
+) {
+  tapa::stream<NodeUpdate, 128> update_q;
+  tapa::stream<nid_t, 16>       req_q;
+  tapa::stream<nid_t, 64>       nbr_q;
+
+  tapa::task()
+    .invoke(ProcessingElement, num_nodes, start_nid, update_q, req_q, nbr_q,
+        level_stats, bitmap_spill, frontier_spill)
+    .invoke<tapa::detach>(NeighborReader, req_q, nbr_q,
+        push_index, push_neighbors)
+    .invoke(DepthWriter, num_nodes, update_q, depths);
+}
+
+void bfs_fpga_parents(
+    const nid_t start_nid, const nid_t num_nodes, 
+    tapa::mmap<offset_t> push_index, tapa::mmap<nid_t> push_neighbors,
+    tapa::mmap<tree_word_t> tree, tapa::mmap<bits<LevelStats>> level_stats,
+    tapa::mmap<Bitmap::tile_word_t> bitmap_spill,
+    tapa::mmap<nid_t> frontier_spill
+) {
+  tapa::stream<NodeUpdate, 128> update_q;
+  tapa::stream<nid_t, 16>       req_q;
+  tapa::stream<nid_t, 64>       nbr_q;
+
+  tapa::task()
+    .invoke(ProcessingElement, num_nodes, start_nid, update_q, req_q, nbr_q,
+        level_stats, bitmap_spill, frontier_spill)
+    .invoke<tapa::detach>(NeighborReader, req_q, nbr_q,
+        push_index, push_neighbors)
+    .invoke(TreeWriter, num_nodes, update_q, tree);
+}
+
+void bfs_fpga_packed(
+    const nid_t start_nid, const nid_t num_nodes, 
+    tapa::mmap<offset_t> packed_index, tapa::mmap<pack_word_t> packed_words,
+    tapa::mmap<depth_t> depths, tapa::mmap<bits<LevelStats>> level_stats,
+    tapa::mmap<Bitmap::tile_word_t> bitmap_spill,
+    tapa::mmap<nid_t> frontier_spill
+) {
+  tapa::stream<NodeUpdate, 128> update_q;
+  tapa::stream<nid_t, 16>       req_q;
+  tapa::stream<nid_t, 64>       nbr_q;
+
+  tapa::task()
+    .invoke(ProcessingElement, num_nodes, start_nid, update_q, req_q, nbr_q,
+        level_stats, bitmap_spill, frontier_spill)
+    .invoke<tapa::detach>(NeighborDecoder, req_q, nbr_q,
+        packed_index, packed_words)
+    .invoke(DepthWriter, num_nodes, update_q, depths);
+}
+
+void bfs_fpga_session(
+    const nid_t num_queries, const nid_t num_nodes, tapa::mmap<nid_t> starts,
+    tapa::mmap<offset_t> push_index, tapa::mmap<nid_t> push_neighbors,
+    tapa::mmap<depth_t> depths, tapa::mmap<cycle_t> query_cycles,
+    tapa::mmap<bits<LevelStats>> level_stats,
+    tapa::mmap<Bitmap::tile_word_t> bitmap_spill,
+    tapa::mmap<nid_t> frontier_spill
+) {
+  tapa::stream<nid_t, 2>        query_q;
+  tapa::stream<NodeUpdate, 128> update_q;
+  tapa::stream<nid_t, 16>       req_q;
+  tapa::stream<nid_t, 64>       nbr_q;
+
+  tapa::task()
+    .invoke(QueryReader, num_queries, starts, query_q)
+    .invoke(SessionPE, num_nodes, query_q, update_q, req_q, nbr_q,
+        level_stats, query_cycles, bitmap_spill, frontier_spill)
+    .invoke<tapa::detach>(NeighborReader, req_q, nbr_q,
+        push_index, push_neighbors)
+    .invoke(SessionDepthWriter, num_queries, num_nodes, update_q, depths);
+}
+
+/**
+ * Merges the nodes discovered by the partition PEs of bfs_fpga_multi.
+ * Each epoch it routes the frontier to the PEs owning it (local IDs) while
+ * collecting the nodes they discover, drops already explored ones and sends
+ * new ones to DepthWriter. Routing and collecting are interleaved so
+ * neither side can block the other.
+ * Parameters:
+ *   - partition_nodes <- partition boundaries (V_NUM_PARTITIONS + 1 entries).
+ *   - bitmap_spill    <- scratch for the explored bitmap.
+ *   - frontier_spill  <- scratch for the ping-pong frontier queues
+ *                        (2 * num_nodes entries).
+ */
+void FrontierMerger(
+    const nid_t start_nid, const nid_t num_nodes,
+    tapa::mmap<nid_t> partition_nodes,
+    tapa::ostreams<bool, V_NUM_PARTITIONS> &active_q,
+    tapa::ostreams<nid_t, V_NUM_PARTITIONS> &frontier_q,
+    tapa::istreams<NodeUpdate, V_NUM_PARTITIONS> &discover_q,
+    tapa::ostream<NodeUpdate> &update_q,
+    tapa::mmap<Bitmap::tile_word_t> bitmap_spill,
+    tapa::mmap<nid_t> frontier_spill
+) {
+  nid_t bounds[V_NUM_PARTITIONS + 1];
+#pragma HLS array_partition variable=bounds complete
+  for (int p = 0; p <= V_NUM_PARTITIONS; p++) bounds[p] = partition_nodes[p];
+
+  Bitmap::TiledBitmap explored;
+  explored.reset(bitmap_spill, 0, num_nodes);
+
+  // Setup starting node.
+  explored.set(bitmap_spill, start_nid);
+  update_q.write({start_nid, start_nid}); // Depth update for starting node.
+  update_q.close();
+  frontier_spill[0] = start_nid;
+  nid_t frontier_size = 1;
+
+  for (nid_t epoch = 0; frontier_size != 0; epoch++) {
+#pragma HLS loop_tripcount max=2048
+    const nid_t cur  = (epoch & 1) * num_nodes;
+    const nid_t next = num_nodes - cur;
+    for (int p = 0; p < V_NUM_PARTITIONS; p++) {
 #pragma HLS unroll
-      if (Bitmap::get_bit(frontier, u)) {
-        DEBUG(std::cout << "[Push] node " << u << ": ");
-
-        push_neis:
-        for (offset_t off = push_index[u]; off < push_index[u + 1]; off++) {
-#pragma HLS pipeline
-          nid_t v = push_neighbors[off];
-          if (not Bitmap::get_bit(explored, v)) { // If child not explored.
-            DEBUG(std::cout << v << " ");
-            Bitmap::set_bit(explored, v);
-            Bitmap::set_bit(next_frontier, v);
-            update_q.write(v);
-            num_updates++;
-          }
-        }          
-        DEBUG(std::cout << std::endl);
+      active_q[p].write(true);
+    }
+
+    nid_t num_routed  = 0;
+    nid_t num_updates = 0;
+    bool  done[V_NUM_PARTITIONS]   = {};
+    bool  closed[V_NUM_PARTITIONS] = {}; // frontier_q[p] got its EoT.
+#pragma HLS array_partition variable=done complete
+#pragma HLS array_partition variable=closed complete
+    int   num_done = 0;
+    merge:
+    while (num_done < V_NUM_PARTITIONS) {
+#pragma HLS pipeline II=1
+      // Route one frontier node to its owner.
+      if (num_routed < frontier_size) {
+        nid_t u = frontier_spill[cur + num_routed];
+        int owner = 0;
+        for (int p = 1; p < V_NUM_PARTITIONS; p++) {
+#pragma HLS unroll
+          if (u >= bounds[p]) owner = p;
+        }
+        if (frontier_q[owner].try_write(u - bounds[owner])) num_routed++;
+      } else {
+        // End the PEs' frontiers; a full queue is retried next iteration.
+        for (int p = 0; p < V_NUM_PARTITIONS; p++) {
+#pragma HLS unroll
+          if (not closed[p]) closed[p] = frontier_q[p].try_close();
+        }
+      }
+
+      // Collect discovered nodes until every PE finished the epoch.
+      for (int p = 0; p < V_NUM_PARTITIONS; p++) {
+#pragma HLS unroll
+        bool valid;
+        bool is_eot = discover_q[p].eot(valid);
+        if (done[p] or not valid) continue;
+        if (is_eot) {
+          discover_q[p].open();
+          done[p] = true;
+          num_done++;
+          continue;
+        }
+        NodeUpdate update = discover_q[p].read(nullptr);
+        nid_t v = update.node;
+        if (not explored.get(bitmap_spill, v)) {
+          explored.set(bitmap_spill, v);
+          update_q.write({v, update.parent + bounds[p]}); // Global parent.
+          frontier_spill[next + num_updates++] = v;
+        }
       }
     }
     update_q.close(); // Inform DepthWriter the current epoch has ended.
+    DEBUG(std::cout << "[merger] " << num_updates << " new nodes" << std::endl);
+
+    frontier_size = num_updates;
+  }
+
+  // Stop all PEs.
+  for (int p = 0; p < V_NUM_PARTITIONS; p++) {
+#pragma HLS unroll
+    active_q[p].write(false);
+  }
+}
+
+/**
+ * Expands the frontier nodes of one partition of bfs_fpga_multi. Frontier
+ * nodes arrive as local IDs, discovered neighbors leave as global IDs (with
+ * their local parent).
+ * Every neighbor is sent at most once per BFS (tracked in sent), so the
+ * merger sees at most num_nodes nodes per PE.
+ */
+void PartitionPE(
+    const nid_t num_nodes,
+    tapa::istream<bool> &active_q,
+    tapa::istream<nid_t> &frontier_q,
+    tapa::ostream<NodeUpdate> &discover_q,
+    tapa::mmap<offset_t> push_index, tapa::mmap<nid_t> push_neighbors,
+    tapa::mmap<Bitmap::tile_word_t> bitmap_spill
+) {
+  Bitmap::TiledBitmap sent;
+  sent.reset(bitmap_spill, 0, num_nodes);
+
+  while (active_q.read()) {
+#pragma HLS loop_tripcount max=2048
+    TAPA_WHILE_NOT_EOT(frontier_q) {
+      nid_t u = frontier_q.read(nullptr);
 
-    // Swap frontiers.
-    std::swap(frontier, next_frontier);
-    for (size_t i = 0; i < Bitmap::bitmap_size(MAX_NODES); i++)
-      next_frontier[i] = 0;
-  } while (num_updates != 0);
+      push_neis:
+      for (offset_t off = push_index[u]; off < push_index[u + 1]; off++) {
+#pragma HLS pipeline II=1
+        nid_t v = push_neighbors[off];
+        if (not sent.get(bitmap_spill, v)) {
+          sent.set(bitmap_spill, v);
+          discover_q.write({v, u});
+        }
+      }
+    }
+    frontier_q.try_open(); // Reset stream.
+    discover_q.close();    // Inform FrontierMerger this PE is done.
+  }
 }
 
-void DepthWriter(tapa::istream<nid_t> &update_q, tapa::mmap<depth_t> depth) {
+void bfs_fpga_multi(
+    const nid_t start_nid, const nid_t num_nodes,
+    tapa::mmap<nid_t> partition_nodes,
+    tapa::mmaps<offset_t, V_NUM_PARTITIONS> push_index,
+    tapa::mmaps<nid_t, V_NUM_PARTITIONS> push_neighbors,
+    tapa::mmap<depth_t> depths,
+    tapa::mmaps<Bitmap::tile_word_t, V_NUM_PARTITIONS> pe_spill,
+    tapa::mmap<Bitmap::tile_word_t> bitmap_spill,
+    tapa::mmap<nid_t> frontier_spill
+) {
+  tapa::streams<bool, V_NUM_PARTITIONS, 2>    active_q;
+  tapa::streams<nid_t, V_NUM_PARTITIONS, 128> frontier_q;
+  tapa::streams<NodeUpdate, V_NUM_PARTITIONS, 128> discover_q;
+  tapa::stream<NodeUpdate, 128> update_q;
+
+  tapa::task()
+    .invoke(FrontierMerger, start_nid, num_nodes, partition_nodes,
+        active_q, frontier_q, discover_q, update_q, bitmap_spill,
+        frontier_spill)
+    .invoke<tapa::join, V_NUM_PARTITIONS>(PartitionPE, num_nodes,
+        active_q, frontier_q, discover_q, push_index, push_neighbors, pe_spill)
+    .invoke(DepthWriter, num_nodes, update_q, depths);
+}
+
+// Nodes newly reached by a set of sources (bfs_fpga_multi_source).
+struct MaskUpdate {
+  nid_t         node;
+  source_mask_t mask;
+};
+
+/**
+ * Multi-source push BFS (MS-BFS). Instead of single explored/frontier bits,
+ * every node carries a source mask: seen[v] holds the sources that reached
+ * v, visit[q * num_nodes + v] those that reached it in the level held by
+ * frontier queue q. A frontier node's neighbor list is requested once per
+ * level and shared by all of its sources.
+ * Masks take a word per node, so they stay off-chip next to the ping-pong
+ * frontier queues in frontier_spill (as in FrontierMerger).
+ */
+void MultiSourcePE(
+    const nid_t num_sources, const nid_t num_nodes, tapa::mmap<nid_t> sources,
+    tapa::ostream<MaskUpdate> &update_q,
+    tapa::ostream<nid_t> &req_q, tapa::istream<nid_t> &nbr_q,
+    tapa::mmap<source_mask_t> seen, tapa::mmap<source_mask_t> visit,
+    tapa::mmap<nid_t> frontier_spill
+) {
+  assert(num_sources <= MS_BATCH); // One mask bit per source.
+
+  reset_masks:
+  for (nid_t u = 0; u < num_nodes; u++) {
+#pragma HLS pipeline II=1
+    seen[u]              = 0;
+    visit[u]             = 0;
+    visit[num_nodes + u] = 0;
+  }
+
+  // Setup starting nodes (a node may start several sources).
+  nid_t frontier_size = 0;
+  init_sources:
+  for (nid_t i = 0; i < num_sources; i++) {
+    nid_t u = sources[i];
+    source_mask_t mask = visit[u];
+    if (mask == 0) frontier_spill[frontier_size++] = u;
+    seen[u]  = mask | source_mask_t(1) << i;
+    visit[u] = mask | source_mask_t(1) << i;
+    update_q.write({u, source_mask_t(1) << i});
+  }
+  update_q.close();
+
+  for (nid_t epoch = 0; frontier_size != 0; epoch++) {
+#pragma HLS loop_tripcount max=2048
+    const nid_t cur  = (epoch & 1) * num_nodes;
+    const nid_t next = num_nodes - cur;
+    nid_t num_updates = 0;
+
+    nid_t num_requested = 0;
+    nid_t num_done      = 0;
+    bool          has_mask = false;
+    source_mask_t mask     = 0;
+    push:
+    while (num_done < frontier_size) {
+#pragma HLS pipeline II=1
+      // Request the next frontier node's neighbors.
+      if (num_requested < frontier_size) {
+        nid_t u = frontier_spill[cur + num_requested];
+        if (req_q.try_write(u)) num_requested++;
+      }
+
+      // Sources of the list being consumed (lists arrive in request order).
+      // Its visit mask is cleared so the queue is clean two levels later.
+      if (not has_mask) {
+        nid_t u = frontier_spill[cur + num_done];
+        mask = visit[cur + u];
+        visit[cur + u] = 0;
+        has_mask = true;
+      }
+
+      // Process one neighbor.
+      bool valid;
+      bool is_eot = nbr_q.eot(valid);
+      if (not valid) continue;
+      if (is_eot) { // End of list.
+        nbr_q.open();
+        num_done++;
+        has_mask = false;
+        continue;
+      }
+      nid_t v = nbr_q.read(nullptr);
+      source_mask_t seen_v  = seen[v];
+      source_mask_t reached = mask & ~seen_v; // Sources new to v.
+      if (reached != 0) {
+        source_mask_t next_mask = visit[next + v];
+        if (next_mask == 0) frontier_spill[next + num_updates++] = v;
+        seen[v]         = seen_v | reached;
+        visit[next + v] = next_mask | reached;
+        update_q.write({v, reached});
+      }
+    }
+    update_q.close(); // Inform MaskDepthWriter the current epoch has ended.
+    DEBUG(std::cout << "[multi-source] " << num_updates << " new nodes"
+                    << std::endl);
+
+    frontier_size = num_updates;
+  }
+}
+
+// Writes the current depth of every (source, node) pair reached this epoch;
+// source i's depths start at depth[i * num_nodes].
+void MaskDepthWriter(const nid_t num_nodes,
+    tapa::istream<MaskUpdate> &update_q, tapa::mmap<depth_t> depth
+) {
   depth_t cur_depth = 0;
   for (;;) {
     TAPA_WHILE_NOT_EOT(update_q) {
-      auto u = update_q.read(nullptr);
-      depth[u] = cur_depth;
+      auto update = update_q.read(nullptr);
+      write_sources:
+      for (source_mask_t mask = update.mask; mask != 0;
+           Bitmap::clear_lowest_bit(mask)) {
+#pragma HLS pipeline II=1
+#pragma HLS loop_tripcount max=MS_BATCH
+        uint64_t i = Bitmap::lowest_bit(mask);
+        depth[i * num_nodes + update.node] = cur_depth;
+      }
     }
     update_q.try_open(); // Reset stream.
 
@@ -78,16 +604,21 @@ void DepthWriter(tapa::istream<nid_t> &update_q, tapa::mmap<depth_t> depth) {
   }
 }
 
-void bfs_fpga(
-    const nid_t start_nid, const nid_t num_nodes, 
+void bfs_fpga_multi_source(
+    const nid_t num_sources, const nid_t num_nodes, tapa::mmap<nid_t> sources,
     tapa::mmap<offset_t> push_index, tapa::mmap<nid_t> push_neighbors,
-    tapa::mmap<depth_t> depths
+    tapa::mmap<depth_t> depths,
+    tapa::mmap<source_mask_t> seen, tapa::mmap<source_mask_t> visit,
+    tapa::mmap<nid_t> frontier_spill
 ) {
-  assert(num_nodes <= MAX_NODES);
-  tapa::stream<nid_t, 128> update_q;
+  tapa::stream<MaskUpdate, 128> update_q;
+  tapa::stream<nid_t, 16>       req_q;
+  tapa::stream<nid_t, 64>       nbr_q;
 
   tapa::task()
-    .invoke(ProcessingElement, num_nodes, start_nid, update_q, 
+    .invoke(MultiSourcePE, num_sources, num_nodes, sources, update_q,
+        req_q, nbr_q, seen, visit, frontier_spill)
+    .invoke<tapa::detach>(NeighborReader, req_q, nbr_q,
         push_index, push_neighbors)
-    .invoke<tapa::detach>(DepthWriter, update_q, depths);
+    .invoke<tapa::detach>(MaskDepthWriter, num_nodes, update_q, depths);
 }
@@ -8,26 +8,215 @@
 #include <ap_int.h>
 #include <cassert>
 #include <tapa.h>
+#include <vector>
 #include "graph.h"
+#include "level-stats.h"
+#include "packed-graph.h"
+#include "tiled-bitmap.h"
 
 constexpr int V_NUM_PARTITIONS = 2;
 
+using cycle_t = uint64_t; // (Estimated) kernel cycle count.
+
+// One 512-bit memory word (AXI burst beat) of offset_t/nid_t entries.
+using burst_t = ap_uint<512>;
+constexpr int BURST_ENTRIES = 512 / 32;
+static_assert(sizeof(nid_t) == 4 and sizeof(offset_t) == 4,
+              "burst_t entries are 32-bit");
+
+inline nid_t burst_entry(const burst_t &word, int i) {
+  return word.range(32 * i + 31, 32 * i);
+}
+
+// Copies a to whole burst_t words (host side, for the burst_t arrays).
+inline std::vector<nid_t> pad_bursts(const ArrayView<nid_t> &a) {
+  std::vector<nid_t> v(a.begin(), a.end());
+  v.resize((v.size() + BURST_ENTRIES - 1) / BURST_ENTRIES * BURST_ENTRIES);
+  return v;
+}
+
+// Node discovered by a PE and the node it was discovered from.
+struct NodeUpdate {
+  nid_t node;
+  nid_t parent;
+};
+
+// Depth (low half) and parent (high half) of a node in one word, so the
+// BFS tree costs no memory writes on top of the depths.
+using tree_word_t = uint64_t;
+// Unreached node: INVALID_DEPTH and INVALID_NODE.
+constexpr tree_word_t INVALID_TREE_WORD = ~tree_word_t(0);
+
+inline tree_word_t pack_tree_word(depth_t depth, nid_t parent) {
+  return uint32_t(depth) | tree_word_t(uint32_t(parent)) << 32;
+}
+inline depth_t tree_depth(tree_word_t word) { return depth_t(uint32_t(word)); }
+inline nid_t tree_parent(tree_word_t word) { return nid_t(word >> 32); }
+
 //There is a bug in Vitis HLS preventing fully pipelined read/write of struct
 //via m_axi; using ap_uint can work-around this problem.
 //template <typename T>
 //using bits = ap_uint<tapa::widthof<T>()>;
 
+/**
+ * Push BFS. 
+ *   - level_stats    <- LevelStats of every level (needs at least
+ *                       num_nodes + 1 entries).
+ *   - bitmap_spill   <- scratch, Bitmap::spill_size(num_nodes) words.
+ *   - frontier_spill <- scratch, 2 * num_nodes entries.
+ */
 void bfs_fpga(
     const nid_t start, const nid_t num_nodes, 
     tapa::mmap<offset_t> push_index, tapa::mmap<nid_t> push_neighbors,
-    tapa::mmap<depth_t> depth);
+    tapa::mmap<depth_t> depth, tapa::mmap<bits<LevelStats>> level_stats,
+    tapa::mmap<Bitmap::tile_word_t> bitmap_spill,
+    tapa::mmap<nid_t> frontier_spill);
 
-void bfs_switch(
-    nid_t start, nid_t num_nodes, nid_t num_edges,
+/**
+ * bfs_fpga that also outputs the BFS tree: tree[u] packs the depth and
+ * parent of u (see pack_tree_word; the start is its own parent) in place of
+ * depth[u]. Initialize tree to INVALID_TREE_WORD.
+ */
+void bfs_fpga_parents(
+    const nid_t start, const nid_t num_nodes, 
     tapa::mmap<offset_t> push_index, tapa::mmap<nid_t> push_neighbors,
-    tapa::mmap<offset_t> pull_index, tapa::mmap<nid_t> pull_neighbors,
-    tapa::mmap<depth_t> depth);
+    tapa::mmap<tree_word_t> tree, tapa::mmap<bits<LevelStats>> level_stats,
+    tapa::mmap<Bitmap::tile_word_t> bitmap_spill,
+    tapa::mmap<nid_t> frontier_spill);
+
+/**
+ * Push BFS over packed neighbor lists (see packed-graph.h), decoded by a
+ * stage in front of the PE. Scratch buffers are the same as bfs_fpga.
+ */
+void bfs_fpga_packed(
+    const nid_t start, const nid_t num_nodes, 
+    tapa::mmap<offset_t> packed_index, tapa::mmap<pack_word_t> packed_words,
+    tapa::mmap<depth_t> depth, tapa::mmap<bits<LevelStats>> level_stats,
+    tapa::mmap<Bitmap::tile_word_t> bitmap_spill,
+    tapa::mmap<nid_t> frontier_spill);
+
+/**
+ * Push BFS for num_queries start nodes in one invocation, so the graph is
+ * transferred once for all of them (see BfsSession). Scratch buffers are
+ * the same as bfs_fpga.
+ *   - starts       <- start node of every query.
+ *   - depth        <- depths of query q at [q * num_nodes,
+ *                     (q + 1) * num_nodes).
+ *   - query_cycles <- estimated cycles of every query.
+ *   - level_stats  <- LevelStats of every level of the last query.
+ */
+void bfs_fpga_session(
+    const nid_t num_queries, const nid_t num_nodes, tapa::mmap<nid_t> starts,
+    tapa::mmap<offset_t> push_index, tapa::mmap<nid_t> push_neighbors,
+    tapa::mmap<depth_t> depth, tapa::mmap<cycle_t> query_cycles,
+    tapa::mmap<bits<LevelStats>> level_stats,
+    tapa::mmap<Bitmap::tile_word_t> bitmap_spill,
+    tapa::mmap<nid_t> frontier_spill);
+
+/**
+ * Push BFS with one PE per partition (see partition_edges); PE p owns nodes
+ * [partition_nodes[p], partition_nodes[p + 1]) and reads push_index[p] and
+ * push_neighbors[p]. The PE count is V_NUM_PARTITIONS.
+ *   - pe_spill[p]    <- scratch, Bitmap::spill_size(num_nodes) words.
+ *   - bitmap_spill   <- scratch, Bitmap::spill_size(num_nodes) words.
+ *   - frontier_spill <- scratch, 2 * num_nodes entries.
+ */
+void bfs_fpga_multi(
+    const nid_t start, const nid_t num_nodes,
+    tapa::mmap<nid_t> partition_nodes,
+    tapa::mmaps<offset_t, V_NUM_PARTITIONS> push_index,
+    tapa::mmaps<nid_t, V_NUM_PARTITIONS> push_neighbors,
+    tapa::mmap<depth_t> depth,
+    tapa::mmaps<Bitmap::tile_word_t, V_NUM_PARTITIONS> pe_spill,
+    tapa::mmap<Bitmap::tile_word_t> bitmap_spill,
+    tapa::mmap<nid_t> frontier_spill);
+
+/**
+ * Multi-source push BFS: up to MS_BATCH traversals share every neighbor
+ * list scan by carrying a source mask per node (see bfs_cpu_multi_source).
+ *   - sources        <- num_sources start nodes.
+ *   - depth          <- depths of source i at [i * num_nodes,
+ *                       (i + 1) * num_nodes).
+ *   - seen           <- scratch, num_nodes entries.
+ *   - visit          <- scratch, 2 * num_nodes entries.
+ *   - frontier_spill <- scratch, 2 * num_nodes entries.
+ */
+void bfs_fpga_multi_source(
+    const nid_t num_sources, const nid_t num_nodes, tapa::mmap<nid_t> sources,
+    tapa::mmap<offset_t> push_index, tapa::mmap<nid_t> push_neighbors,
+    tapa::mmap<depth_t> depth,
+    tapa::mmap<source_mask_t> seen, tapa::mmap<source_mask_t> visit,
+    tapa::mmap<nid_t> frontier_spill);
+
+// Traversal direction of a bfs_switch epoch.
+enum Mode { push = 0, pull = 1 };
+
+// Default direction-switching thresholds (Beamer et al.).
+constexpr int SWITCH_ALPHA = 15;
+constexpr int SWITCH_BETA  = 18;
+
+/**
+ * Direction-switching BFS. Index and neighbor arrays are read as burst_t
+ * words (pad them to a multiple of BURST_ENTRIES).
+ *   - alpha, beta  <- direction-switching thresholds.
+ *   - degree_index <- push index again (unpadded), for out-degree lookups.
+ *   - bitmap_spill <- scratch, 3 * Bitmap::spill_size(num_nodes) words.
+ *   - level_stats  <- LevelStats of every level (up to num_nodes + 1
+ *                     entries).
+ */
+void bfs_switch(
+    nid_t start, nid_t num_nodes, nid_t num_edges, int alpha, int beta,
+    tapa::mmap<burst_t> push_index, tapa::mmap<burst_t> push_neighbors,
+    tapa::mmap<burst_t> pull_index, tapa::mmap<burst_t> pull_neighbors,
+    tapa::mmap<offset_t> degree_index,
+    tapa::mmap<depth_t> depth, tapa::mmap<Bitmap::tile_word_t> bitmap_spill,
+    tapa::mmap<bits<LevelStats>> level_stats);
+
+// bfs_switch with the BFS tree in place of depth (see bfs_fpga_parents).
+void bfs_switch_parents(
+    nid_t start, nid_t num_nodes, nid_t num_edges, int alpha, int beta,
+    tapa::mmap<burst_t> push_index, tapa::mmap<burst_t> push_neighbors,
+    tapa::mmap<burst_t> pull_index, tapa::mmap<burst_t> pull_neighbors,
+    tapa::mmap<offset_t> degree_index,
+    tapa::mmap<tree_word_t> tree, tapa::mmap<Bitmap::tile_word_t> bitmap_spill,
+    tapa::mmap<bits<LevelStats>> level_stats);
+
+/**
+ * bfs_switch resumed from a frontier prepared by the host (see bfs_coop):
+ * bitmap_spill holds the explored bitmap, the frontier (plane 0) and an
+ * empty plane 1, laid out as in bfs_switch. Runs epochs until the frontier
+ * is empty or has shrunk below handoff nodes.
+ *   - frontier_depth      <- depth of the frontier nodes.
+ *   - frontier_nodes      <- frontier size.
+ *   - prev_frontier_nodes <- size of the frontier before it.
+ *   - frontier_edges      <- out-degree sum of the frontier.
+ *   - unexplored_edges    <- edges not reached by any frontier yet.
+ *   - level_stats         <- LevelStats of every level run, ended by an
+ *                            all-zero entry (see level-stats.h).
+ */
+void bfs_switch_levels(
+    nid_t num_nodes, int alpha, int beta, nid_t handoff,
+    depth_t frontier_depth, nid_t frontier_nodes, nid_t prev_frontier_nodes,
+    offset_t frontier_edges, offset_t unexplored_edges,
+    tapa::mmap<burst_t> push_index, tapa::mmap<burst_t> push_neighbors,
+    tapa::mmap<burst_t> pull_index, tapa::mmap<burst_t> pull_neighbors,
+    tapa::mmap<offset_t> degree_index,
+    tapa::mmap<depth_t> depth, tapa::mmap<Bitmap::tile_word_t> bitmap_spill,
+    tapa::mmap<bits<LevelStats>> level_stats);
+
+void bfs_fpga_edge(const Pid start_id, int interval_bits,
+                    tapa::mmap<offset_t> degree_index,
+                    tapa::mmaps<offset_t, PARTITION_NUM> edge_index,
+                    tapa::mmaps<nid_t, PARTITION_NUM> edges,
+                    tapa::mmaps<VertexAttr, PARTITION_NUM> vertices,
+                    tapa::mmap<bits<Resp>> queue, tapa::mmap<bits<LevelStats>> level_stats);
 
-void bfs_fpga_edge(Pid num_partitions, const Pid start_id, tapa::mmap<const Eid> num_edges, tapa::mmap<const Eid> edge_offsets, 
-                    tapa::mmap<VertexAttr> vertices, tapa::mmap<bits<Edge>> edges);
+// bfs_fpga_edge with the BFS tree in place of the depths (see
+// bfs_fpga_parents); on-chip intervals hold half as many vertices.
+void bfs_fpga_edge_parents(const Pid start_id, int interval_bits,
+                    tapa::mmap<offset_t> degree_index,
+                    tapa::mmaps<offset_t, PARTITION_NUM> edge_index,
+                    tapa::mmaps<nid_t, PARTITION_NUM> edges,
+                    tapa::mmaps<tree_word_t, PARTITION_NUM> tree,
+                    tapa::mmap<bits<Resp>> queue, tapa::mmap<bits<LevelStats>> level_stats);
 #endif  // BFS_FPGA_H
@@ -1,47 +1,137 @@
 #define DEBUG_ON
 #define VERTEX_CENTRIC
 // #define SECOND_SWITCH
+// #define MULTI_PE
+// #define PACKED_NEIGHBORS
+// #define MULTI_SOURCE // BFS_SOURCES traversals, MS_BATCH per graph pass.
+// #define SESSION      // Many queries against one resident graph.
+// #define COOPERATIVE  // Small levels on CPU, large ones on FPGA.
+// #define PARENTS      // BFS tree next to the depths (plain, SECOND_SWITCH and edge-centric).
 
 constexpr int NUM_PARTITIONS = 2;
 
+#if defined(PARENTS) and (defined(MULTI_PE) or defined(PACKED_NEIGHBORS) or \
+    defined(MULTI_SOURCE) or defined(SESSION) or defined(COOPERATIVE))
+#error "PARENTS needs the plain, SECOND_SWITCH or edge-centric kernel"
+#endif
+
 #include <algorithm>
+#include <array>
+#include <chrono>
 #include <cstdint>
 #include <iostream>
-#include <fstream>
 #include <vector>
 #include <string>
 #include <tapa.h>
 
 #include "graph.h"
+#include "graph-file.h"
+#include "graph-gen.h"
+#include "packed-graph.h"
+#include "reorder.h"
 #include "bfs-fpga.h"
+#include "bfs-coop.h"
 #include "bfs-cpu.h"
+#include "bfs-session.h"
+#include "bfs-validate.h"
 #include "util.h"
 
 constexpr nid_t    PRINT_MAX_NODES  = 10;
 constexpr offset_t PRINT_MAX_EDGES  = 30;
-constexpr nid_t    PRINT_MAX_ERRORS = 10;
-
-int main(int argc, char *argv[]) {
-  // Load graph.
-  std::ifstream ifs(argv[1]);
-  auto edge_list = load_edgelist(ifs);
 
-  DEBUG(
-  if (edge_list.size() <= PRINT_MAX_EDGES) {
-    std::cout << "Edge list (before rename):" << std::endl;
-    for (auto &edge : edge_list)
-      std::cout << edge.first << " " << edge.second << std::endl;
-  });
+/**
+ * Validates depths from root with the Graph500 checks (see validate_bfs)
+ * and prints the first failure.
+ * Parameters:
+ *   - pull_g  <- pull graph of the traversed graph.
+ *   - engine  <- name of the engine that computed depths (for messages).
+ *   - parents <- (optional) parents to check as well.
+ * Returns the number of nodes failing a check.
+ */
+static nid_t count_errors(const GraphView &pull_g, nid_t root,
+    const depth_t *depths, const std::string &engine,
+    const nid_t *parents = nullptr
+) {
+  auto validation = validate_bfs(pull_g, root, depths, 0, parents);
+  if (validation.num_errors != 0) {
+    std::cerr << "[error] " << engine << ": "
+              << validation.num_errors << " nodes fail validation, first "
+              << validation.first_node << " ("
+              << bfs_error_name(validation.first_error) << ", depth "
+              << (validation.first_node >= 0 ? depths[validation.first_node]
+                                             : INVALID_DEPTH)
+              << ")" << std::endl;
+  }
+  return validation.num_errors;
+}
 
-  // Build push and pull graphs.
-  PushGraph pushG;
-  PullGraph pullG;
+// Writes level_stats to $BFS_STATS (CSV, or JSON for *.json) if it is set.
+static bool dump_level_stats(const std::vector<LevelStats> &level_stats) {
+  const auto path_ptr = getenv("BFS_STATS");
+  if (not path_ptr) return true;
+  if (not write_level_stats(path_ptr, level_stats)) return false;
+  std::cout << "Level stats written to " << path_ptr << std::endl;
+  return true;
+}
 
-  // @Feiqian rename edge list.
-  build_graphs(edge_list, &pushG, &pullG);
+int main(int argc, char *argv[]) {
+  // Load graph. Graph files (see graph-convert) are mapped as is, text edge
+  // lists are parsed and synthetic graphs (see parse_graph_spec) generated,
+  // then converted.
+  PushGraph push_csr;
+  PullGraph pull_csr;
+  GraphFile graph_file;
+  GraphView pushG;
+  GraphView pullG;
+  edge_list_t edge_list;
+  GraphSpec graph_spec;
+  auto load_start = std::chrono::steady_clock::now();
+  if (is_graph_file(argv[1])) {
+    if (not graph_file.open(argv[1])) return EXIT_FAILURE;
+    pushG = graph_file.push();
+    pullG = graph_file.pull();
+    std::chrono::duration<double> load_time =
+      std::chrono::steady_clock::now() - load_start;
+    std::cout << "Mapped " << pushG.num_nodes << " nodes, "
+              << pushG.num_edges << " edges in " << load_time.count() << " s"
+              << std::endl;
+  } else if (parse_graph_spec(argv[1], &graph_spec)) {
+    // Synthetic graph, e.g. kronecker:20:16 (seed from BFS_SEED).
+    uint64_t seed = 1;
+    if (const auto seed_ptr = getenv("BFS_SEED")) seed = strtoull(seed_ptr,
+                                                                  nullptr, 0);
+    edge_list = generate_edges(graph_spec, seed);
+    std::chrono::duration<double> load_time =
+      std::chrono::steady_clock::now() - load_start;
+    std::cout << "Generated " << edge_list.size() << " edges in "
+              << load_time.count() << " s" << std::endl;
+  } else {
+    std::size_t file_size;
+    edge_list = load_edgelist(argv[1], 0, &file_size);
+    std::chrono::duration<double> load_time =
+      std::chrono::steady_clock::now() - load_start;
+    if (edge_list.empty()) {
+      std::cerr << "[error] no edges loaded from " << argv[1] << std::endl;
+      return EXIT_FAILURE;
+    }
+    std::cout << "Loaded " << edge_list.size() << " edges ("
+              << file_size / 1e6 << " MB) in " << load_time.count() << " s ("
+              << file_size / 1e6 / load_time.count() << " MB/s)" << std::endl;
+  }
+  if (not edge_list.empty()) {
+    DEBUG(
+    if (edge_list.size() <= PRINT_MAX_EDGES) {
+      std::cout << "Edge list (before rename):" << std::endl;
+      for (auto &edge : edge_list)
+        std::cout << edge.first << " " << edge.second << std::endl;
+    });
 
-  // @Feiqian sort by parent node (i.e., edge (u, v) is sorted by ascending u).
-  std::sort(edge_list.begin(), edge_list.end(), AscendingParentNode);  
+    // Build push and pull graphs.
+    // @Feiqian rename edge list.
+    build_graphs(edge_list, &push_csr, &pull_csr);
+    pushG = push_csr;
+    pullG = pull_csr;
+  }
 
   // Validate constructed edge list and graph.
   {
@@ -83,45 +173,404 @@ int main(int argc, char *argv[]) {
       }
     });
   }
-#ifdef VERTEX_CENTRIC
-  // Run and validate FPGA kernel.
+
+  // Optionally renumber nodes for locality (BFS_ORDER=degree|rcm|gorder).
+  // Kernels run on the renumbered graphs; depths are mapped back to the
+  // original IDs with new_ids.
+  GraphView origPullG = pullG;
+  PushGraph push_ordered;
+  PullGraph pull_ordered;
+  nid_vec_t new_ids;
+  if (const auto order_ptr = getenv("BFS_ORDER")) {
+    Ordering ordering;
+    if (not parse_ordering(order_ptr, &ordering)) {
+      std::cerr << "[error] unknown BFS_ORDER " << order_ptr << std::endl;
+      return EXIT_FAILURE;
+    }
+    auto order_start = std::chrono::steady_clock::now();
+    new_ids = compute_ordering(pushG, pullG, ordering);
+    push_ordered = permute_graph(pushG, new_ids);
+    pull_ordered = permute_graph(pullG, new_ids);
+    std::chrono::duration<double> order_time =
+      std::chrono::steady_clock::now() - order_start;
+
+    auto before = locality_stats(pushG);
+    pushG = push_ordered;
+    pullG = pull_ordered;
+    auto after = locality_stats(pushG);
+    std::cout << "Reordered (" << order_ptr << ") in " << order_time.count()
+              << " s: neighbor gap " << before.gap_bits << " -> "
+              << after.gap_bits << " bits, depth line changes "
+              << before.line_change << " -> " << after.line_change
+              << " per edge" << std::endl;
+  }
+
+#ifdef MULTI_SOURCE
+  // Run and validate BFS_SOURCES traversals (default MS_BATCH); every batch
+  // of MS_BATCH of them shares its graph passes.
   {
-    nid_t start_nid = pullG.num_nodes / 8; // Arbitrary.
+    const nid_t num_nodes = pushG.num_nodes;
+    int num_sources = MS_BATCH;
+    if (const auto sources_ptr = getenv("BFS_SOURCES"))
+      num_sources = atoi(sources_ptr);
+    if (num_sources <= 0) {
+      std::cerr << "[error] BFS_SOURCES must be positive" << std::endl;
+      return EXIT_FAILURE;
+    }
+    nid_vec_t orig_sources(num_sources);
+    nid_vec_t sources(num_sources);
+    for (int i = 0; i < num_sources; i++) {
+      orig_sources[i] = int64_t(i) * num_nodes / num_sources; // Spread out.
+      sources[i] = new_ids.empty() ? orig_sources[i] : new_ids[orig_sources[i]];
+    }
+    const std::size_t all_size = std::size_t(num_sources) * num_nodes;
+
+    std::string bitstream;
+    if (const auto bitstream_ptr = getenv("TAPAB")) {
+      bitstream = bitstream_ptr;
+    }
+
+    // The kernel takes at most MS_BATCH sources (one mask bit each).
+    std::vector<depth_t> fpga_depths(all_size, INVALID_DEPTH);
+    std::vector<source_mask_t> seen(num_nodes);
+    std::vector<source_mask_t> visit(2 * num_nodes);
+    std::vector<nid_t> frontier_spill(2 * num_nodes);
+    for (int first = 0; first < num_sources; first += MS_BATCH) {
+      const int batch_size = std::min(MS_BATCH, num_sources - first);
+      nid_vec_t batch(sources.begin() + first,
+                      sources.begin() + first + batch_size);
+      std::vector<depth_t> batch_depths(std::size_t(batch_size) * num_nodes,
+                                        INVALID_DEPTH);
+      tapa::invoke(
+          bfs_fpga_multi_source, bitstream,
+          batch_size, num_nodes, tapa::read_only_mmap<nid_t>(batch),
+          tapa::read_only_mmap<offset_t>(pushG.index),
+          tapa::read_only_mmap<nid_t>(pushG.neighbors),
+          tapa::read_write_mmap<depth_t>(batch_depths),
+          tapa::read_write_mmap<source_mask_t>(seen),
+          tapa::read_write_mmap<source_mask_t>(visit),
+          tapa::read_write_mmap<nid_t>(frontier_spill));
+      std::copy(batch_depths.begin(), batch_depths.end(),
+                fpga_depths.begin() + std::size_t(first) * num_nodes);
+    }
+
+    // Batched CPU traversal against one traversal per source.
+    std::vector<depth_t> cpu_depths(all_size, INVALID_DEPTH);
+    auto batch_start = std::chrono::steady_clock::now();
+    bfs_cpu_multi_source(pushG, sources, cpu_depths);
+    std::chrono::duration<double> batch_time =
+      std::chrono::steady_clock::now() - batch_start;
+    std::vector<depth_t> single_depths(num_nodes);
+    auto single_start = std::chrono::steady_clock::now();
+    for (auto source : sources) {
+      std::fill(single_depths.begin(), single_depths.end(), INVALID_DEPTH);
+      bfs_cpu_push(pushG, source, single_depths);
+    }
+    std::chrono::duration<double> single_time =
+      std::chrono::steady_clock::now() - single_start;
+    std::cout << "CPU, " << num_sources << " sources: " << batch_time.count()
+              << " s batched, " << single_time.count() << " s one by one"
+              << std::endl;
+
+    // Validate every source on the original graph.
+    nid_t err_count = 0;
+    for (int i = 0; i < num_sources; i++) {
+      const std::size_t row = std::size_t(i) * num_nodes;
+      std::vector<depth_t> fpga_row(fpga_depths.begin() + row,
+                                    fpga_depths.begin() + row + num_nodes);
+      std::vector<depth_t> cpu_row(cpu_depths.begin() + row,
+                                   cpu_depths.begin() + row + num_nodes);
+      if (not new_ids.empty()) {
+        fpga_row = unpermute(fpga_row, new_ids);
+        cpu_row  = unpermute(cpu_row, new_ids);
+      }
+      std::string source = "(source " + std::to_string(i) + ")";
+      err_count += count_errors(origPullG, orig_sources[i], fpga_row.data(),
+                                "fpga " + source);
+      err_count += count_errors(origPullG, orig_sources[i], cpu_row.data(),
+                                "cpu " + source);
+    }
+    if (err_count != 0) return EXIT_FAILURE;
+    else /* Success */  std::cout << "Validation success!" << std::endl;
+  }
+#elif defined(SESSION)
+  // Run and validate BFS_QUERIES queries (default 16) through one session.
+  {
+    const nid_t num_nodes = pushG.num_nodes;
+    int num_queries = 16;
+    if (const auto queries_ptr = getenv("BFS_QUERIES"))
+      num_queries = atoi(queries_ptr);
+    nid_vec_t orig_starts(num_queries);
+    for (int q = 0; q < num_queries; q++)
+      orig_starts[q] = int64_t(q) * num_nodes / num_queries; // Spread out.
+
+    std::string bitstream;
+    if (const auto bitstream_ptr = getenv("TAPAB")) {
+      bitstream = bitstream_ptr;
+    }
+
+    BfsSession session(pushG, bitstream);
+    for (auto start : orig_starts)
+      session.submit(new_ids.empty() ? start : new_ids[start]);
+    auto session_start = std::chrono::steady_clock::now();
+    auto fpga_depths = session.run();
+    std::chrono::duration<double> session_time =
+      std::chrono::steady_clock::now() - session_start;
+
+    if (not dump_level_stats(session.level_stats())) return EXIT_FAILURE;
+
+    // Same queries with one invocation (and graph transfer) each.
+    std::vector<depth_t> single_depths(num_nodes);
+    std::vector<LevelStats> level_stats(num_nodes + 1);
+    std::vector<Bitmap::tile_word_t> bitmap_spill(
+        Bitmap::spill_size(num_nodes));
+    std::vector<nid_t> frontier_spill(2 * num_nodes);
+    auto single_start = std::chrono::steady_clock::now();
+    for (auto start : orig_starts) {
+      std::fill(single_depths.begin(), single_depths.end(), INVALID_DEPTH);
+      tapa::invoke(
+          bfs_fpga, bitstream,
+          new_ids.empty() ? start : new_ids[start], num_nodes,
+          tapa::read_only_mmap<offset_t>(pushG.index),
+          tapa::read_only_mmap<nid_t>(pushG.neighbors),
+          tapa::read_write_mmap<depth_t>(single_depths),
+          tapa::read_write_mmap<LevelStats>(level_stats)
+            .reinterpret<bits<LevelStats>>(),
+          tapa::read_write_mmap<Bitmap::tile_word_t>(bitmap_spill),
+          tapa::read_write_mmap<nid_t>(frontier_spill));
+    }
+    std::chrono::duration<double> single_time =
+      std::chrono::steady_clock::now() - single_start;
+
+    cycle_t total_cycles = 0;
+    for (auto cycles : session.query_cycles()) total_cycles += cycles;
+    std::cout << num_queries << " queries: " << session_time.count()
+              << " s in one session, " << single_time.count()
+              << " s one invocation each; kernel cycles (estimated) "
+              << total_cycles / std::max(num_queries, 1) << " per query"
+              << std::endl;
+
+    // Validate every query on the original graph.
+    nid_t err_count = 0;
+    for (int q = 0; q < num_queries; q++) {
+      const std::size_t row = std::size_t(q) * num_nodes;
+      std::vector<depth_t> query_depths(fpga_depths.begin() + row,
+                                        fpga_depths.begin() + row + num_nodes);
+      if (not new_ids.empty()) query_depths = unpermute(query_depths, new_ids);
+      err_count += count_errors(origPullG, orig_starts[q], query_depths.data(),
+                                "fpga (query " + std::to_string(q) + ")");
+    }
+    if (err_count != 0) return EXIT_FAILURE;
+    else /* Success */  std::cout << "Validation success!" << std::endl;
+  }
+#elif defined(COOPERATIVE)
+  // Run and validate cooperative CPU + FPGA BFS. Frontiers of BFS_HANDOFF
+  // nodes or more (default: 1 / SWITCH_BETA of the nodes) go to FPGA.
+  {
+    nid_t orig_start_nid = pullG.num_nodes / 8; // Arbitrary.
+    nid_t start_nid = new_ids.empty() ? orig_start_nid : new_ids[orig_start_nid];
     std::vector<depth_t> fpga_depths(pullG.num_nodes, INVALID_DEPTH);
 
     std::string bitstream;
     if (const auto bitstream_ptr = getenv("TAPAB")) {
       bitstream = bitstream_ptr;
     }
+    nid_t handoff = pushG.num_nodes / SWITCH_BETA;
+    if (const auto handoff_ptr = getenv("BFS_HANDOFF")) handoff = atoi(handoff_ptr);
+    int alpha = SWITCH_ALPHA, beta = SWITCH_BETA;
+    if (const auto alpha_ptr = getenv("BFS_ALPHA")) alpha = atoi(alpha_ptr);
+    if (const auto beta_ptr = getenv("BFS_BETA"))   beta  = atoi(beta_ptr);
 
-    //auto partition = partition_edges(&pushG, V_NUM_PARTITIONS);
-    //auto index_es = std::get<0>(partition);
-    //auto neighbors_es = std::get<1>(partition);
-    //auto num_nodes = std::get<2>(partition);
+    auto spans = bfs_coop(pushG, pullG, start_nid, fpga_depths, handoff,
+                          alpha, beta, bitstream);
+    std::cout << "Cooperative BFS (hand-off at " << handoff << " nodes):"
+              << std::endl;
+    for (auto &span : spans) {
+      if (span.first_depth == span.last_depth)
+        std::cout << "  level " << span.first_depth;
+      else
+        std::cout << "  levels " << span.first_depth << "-" << span.last_depth;
+      std::cout << ": " << (span.on_fpga ? "fpga" : "cpu");
+      if (span.on_fpga) {
+        std::cout << " (";
+        for (std::size_t i = 0; i < span.modes.size(); i++)
+          std::cout << (i ? " " : "")
+                    << (span.modes[i] == Mode::push ? "push" : "pull");
+        std::cout << ")";
+      }
+      std::cout << ", " << span.num_nodes << " nodes, " << span.seconds
+                << " s" << std::endl;
+    }
+    if (not new_ids.empty()) fpga_depths = unpermute(fpga_depths, new_ids);
 
-    //DEBUG(
-    //for (int i = 0; i < V_NUM_PARTITIONS; i++) {
-      //std::cout << "Partition " << i << ": " << (num_nodes[i + 1] - num_nodes[i])
-                //<< " nodes and " << neighbors_es[i].size() << " edges" << std::endl;
-    //});
+    // Validate on the original graph.
+    nid_t err_count = count_errors(origPullG, orig_start_nid,
+                                   fpga_depths.data(), "coop");
+    if (err_count != 0) return EXIT_FAILURE;
+    else /* Success */  std::cout << "Validation success!" << std::endl;
+  }
+#elif defined(VERTEX_CENTRIC)
+  // Run and validate FPGA kernel.
+  {
+    nid_t orig_start_nid = pullG.num_nodes / 8; // Arbitrary.
+    nid_t start_nid = new_ids.empty() ? orig_start_nid : new_ids[orig_start_nid];
+    std::vector<depth_t> fpga_depths(pullG.num_nodes, INVALID_DEPTH);
+    #ifdef PARENTS
+    // Depth and parent of every node (see pack_tree_word).
+    std::vector<tree_word_t> tree(pullG.num_nodes, INVALID_TREE_WORD);
+    #endif
+
+    std::string bitstream;
+    if (const auto bitstream_ptr = getenv("TAPAB")) {
+      bitstream = bitstream_ptr;
+    }
 
     #ifdef SECOND_SWITCH
+    std::vector<Bitmap::tile_word_t> bitmap_spill(
+        3 * Bitmap::spill_size(pushG.num_nodes));
+    auto push_index     = pad_bursts(pushG.index);
+    auto push_neighbors = pad_bursts(pushG.neighbors);
+    auto pull_index     = pad_bursts(pullG.index);
+    auto pull_neighbors = pad_bursts(pullG.neighbors);
+    // Thresholds can be tuned without rebuilding the kernel.
+    int alpha = SWITCH_ALPHA, beta = SWITCH_BETA;
+    if (const auto alpha_ptr = getenv("BFS_ALPHA")) alpha = atoi(alpha_ptr);
+    if (const auto beta_ptr = getenv("BFS_BETA"))   beta  = atoi(beta_ptr);
+    std::vector<LevelStats> level_stats(pushG.num_nodes + 1);
+      #ifdef PARENTS
+    tapa::invoke(
+        bfs_switch_parents, bitstream, start_nid, pushG.num_nodes,
+        pushG.num_edges, alpha, beta,
+        tapa::read_only_mmap<offset_t>(push_index).reinterpret<burst_t>(),
+        tapa::read_only_mmap<nid_t>(push_neighbors).reinterpret<burst_t>(),
+        tapa::read_only_mmap<offset_t>(pull_index).reinterpret<burst_t>(),
+        tapa::read_only_mmap<nid_t>(pull_neighbors).reinterpret<burst_t>(),
+        tapa::read_only_mmap<offset_t>(pushG.index),
+        tapa::read_write_mmap<tree_word_t>(tree),
+        tapa::read_write_mmap<Bitmap::tile_word_t>(bitmap_spill),
+        tapa::read_write_mmap<LevelStats>(level_stats)
+          .reinterpret<bits<LevelStats>>());
+      #else
     tapa::invoke(
         bfs_switch, bitstream, start_nid, pushG.num_nodes, pushG.num_edges,
+        alpha, beta,
+        tapa::read_only_mmap<offset_t>(push_index).reinterpret<burst_t>(),
+        tapa::read_only_mmap<nid_t>(push_neighbors).reinterpret<burst_t>(),
+        tapa::read_only_mmap<offset_t>(pull_index).reinterpret<burst_t>(),
+        tapa::read_only_mmap<nid_t>(pull_neighbors).reinterpret<burst_t>(),
         tapa::read_only_mmap<offset_t>(pushG.index),
-        tapa::read_only_mmap<nid_t>(pushG.neighbors),
-        tapa::read_only_mmap<offset_t>(pullG.index),
-        tapa::read_only_mmap<nid_t>(pullG.neighbors),
-        tapa::read_write_mmap<depth_t>(fpga_depths));
+        tapa::read_write_mmap<depth_t>(fpga_depths),
+        tapa::read_write_mmap<Bitmap::tile_word_t>(bitmap_spill),
+        tapa::read_write_mmap<LevelStats>(level_stats)
+          .reinterpret<bits<LevelStats>>());
+      #endif
+
+    std::cout << "Directions (alpha " << alpha << ", beta " << beta << "):";
+    for (std::size_t level = 0; level < num_levels(level_stats); level++)
+      std::cout << (level_stats[level].mode == Mode::push ? " push" : " pull");
+    std::cout << std::endl;
+    if (not dump_level_stats(level_stats)) return EXIT_FAILURE;
+    #elif defined(MULTI_PE)
+    auto partition = partition_edges(pushG, V_NUM_PARTITIONS);
+    auto num_nodes = std::get<2>(partition);
+    std::array<offset_vec_t, V_NUM_PARTITIONS> index_es;
+    std::array<nid_vec_t, V_NUM_PARTITIONS> neighbors_es;
+    std::array<std::vector<Bitmap::tile_word_t>, V_NUM_PARTITIONS> pe_spill;
+    for (int i = 0; i < V_NUM_PARTITIONS; i++) {
+      index_es[i] = std::move(std::get<0>(partition)[i]);
+      neighbors_es[i] = std::move(std::get<1>(partition)[i]);
+      pe_spill[i].resize(Bitmap::spill_size(pushG.num_nodes));
+      // Partitions without edges still need a non-empty buffer.
+      if (neighbors_es[i].empty()) neighbors_es[i].push_back(0);
+    }
+
+    DEBUG(
+    for (int i = 0; i < V_NUM_PARTITIONS; i++) {
+      std::cout << "Partition " << i << ": " << (num_nodes[i + 1] - num_nodes[i])
+                << " nodes and " << neighbors_es[i].size() << " edges" << std::endl;
+    });
+
+    std::vector<Bitmap::tile_word_t> bitmap_spill(
+        Bitmap::spill_size(pushG.num_nodes));
+    std::vector<nid_t> frontier_spill(2 * pushG.num_nodes);
+    tapa::invoke(
+        bfs_fpga_multi, bitstream,
+        start_nid, pushG.num_nodes,
+        tapa::read_only_mmap<nid_t>(num_nodes),
+        tapa::read_only_mmaps<offset_t, V_NUM_PARTITIONS>(index_es),
+        tapa::read_only_mmaps<nid_t, V_NUM_PARTITIONS>(neighbors_es),
+        tapa::read_write_mmap<depth_t>(fpga_depths),
+        tapa::read_write_mmaps<Bitmap::tile_word_t, V_NUM_PARTITIONS>(pe_spill),
+        tapa::read_write_mmap<Bitmap::tile_word_t>(bitmap_spill),
+        tapa::read_write_mmap<nid_t>(frontier_spill));
     #else
+    std::vector<LevelStats> level_stats(pushG.num_nodes + 1);
+    std::vector<Bitmap::tile_word_t> bitmap_spill(
+        Bitmap::spill_size(pushG.num_nodes));
+    std::vector<nid_t> frontier_spill(2 * pushG.num_nodes);
+      #ifdef PACKED_NEIGHBORS
+    auto packedG = pack_graph(pushG);
+    std::cout << "Packed neighbors: "
+              << double(packedG.bytes()) / packedG.num_edges
+              << " bytes/edge (CSR: "
+              << double(pushG.index.size() + pushG.neighbors.size())
+                 * sizeof(nid_t) / pushG.num_edges << ")" << std::endl;
+    tapa::invoke(
+        bfs_fpga_packed, bitstream, 
+        start_nid, pushG.num_nodes, 
+        tapa::read_only_mmap<offset_t>(packedG.index),
+        tapa::read_only_mmap<pack_word_t>(packedG.words),
+        tapa::read_write_mmap<depth_t>(fpga_depths),
+        tapa::read_write_mmap<LevelStats>(level_stats)
+          .reinterpret<bits<LevelStats>>(),
+        tapa::read_write_mmap<Bitmap::tile_word_t>(bitmap_spill),
+        tapa::read_write_mmap<nid_t>(frontier_spill));
+      #elif defined(PARENTS)
+    tapa::invoke(
+        bfs_fpga_parents, bitstream, 
+        start_nid, pushG.num_nodes, 
+        tapa::read_only_mmap<offset_t>(pushG.index),
+        tapa::read_only_mmap<nid_t>(pushG.neighbors),
+        tapa::read_write_mmap<tree_word_t>(tree),
+        tapa::read_write_mmap<LevelStats>(level_stats)
+          .reinterpret<bits<LevelStats>>(),
+        tapa::read_write_mmap<Bitmap::tile_word_t>(bitmap_spill),
+        tapa::read_write_mmap<nid_t>(frontier_spill));
+      #else
     tapa::invoke(
         bfs_fpga, bitstream, 
         start_nid, pushG.num_nodes, 
         tapa::read_only_mmap<offset_t>(pushG.index),
         tapa::read_only_mmap<nid_t>(pushG.neighbors),
-        tapa::read_write_mmap<depth_t>(fpga_depths));
-    #endif
+        tapa::read_write_mmap<depth_t>(fpga_depths),
+        tapa::read_write_mmap<LevelStats>(level_stats)
+          .reinterpret<bits<LevelStats>>(),
+        tapa::read_write_mmap<Bitmap::tile_word_t>(bitmap_spill),
+        tapa::read_write_mmap<nid_t>(frontier_spill));
+      #endif
 
+    cycle_t total_cycles = 0;
+    for (std::size_t level = 0; level < num_levels(level_stats); level++) {
+      DEBUG(std::cout << "Level " << level << ": "
+                      << level_stats[level].cycles << " cycles" << std::endl);
+      total_cycles += level_stats[level].cycles;
+    }
+    std::cout << "Kernel cycles (estimated): " << total_cycles << std::endl;
+    if (not dump_level_stats(level_stats)) return EXIT_FAILURE;
+    #endif
+    #ifdef PARENTS
+    nid_vec_t fpga_parents(tree.size());
+    for (std::size_t u = 0; u < tree.size(); u++) {
+      fpga_depths[u]  = tree_depth(tree[u]);
+      fpga_parents[u] = tree_parent(tree[u]);
+    }
+    if (not new_ids.empty())
+      fpga_parents = unpermute_parents(fpga_parents, new_ids);
+    const nid_t *parents = fpga_parents.data();
+    #else
+    const nid_t *parents = nullptr;
+    #endif
+    if (not new_ids.empty()) fpga_depths = unpermute(fpga_depths, new_ids);
 
     DEBUG(
     if (pushG.num_nodes <= PRINT_MAX_NODES) {
@@ -130,87 +579,85 @@ int main(int argc, char *argv[]) {
       std::cout << std::endl;
     });
 
-    std::vector<depth_t> validation_depths(pushG.num_nodes, INVALID_DEPTH);
-    bfs_cpu_push(pushG, start_nid, validation_depths);
-
-    nid_t err_count = 0;
-    for (nid_t u = 0; u < pushG.num_nodes; u++) {
-      if (fpga_depths[u] != validation_depths[u]) {
-        if (err_count < PRINT_MAX_ERRORS) {
-          std::cerr << "[error] node " << u << " fpga depth (" 
-                    << fpga_depths[u] << ") != oracle depth ("
-                    << validation_depths[u] << ")" << std::endl;
-        }
-        err_count++;
-      }
-    }
-    if (err_count >= PRINT_MAX_ERRORS) {
-      std::cerr << "[error] ... " << std::endl
-                << "[error] and " << (err_count - PRINT_MAX_ERRORS)
-                << " more errors" << std::endl;
-    }
+    // Validate on the original graph.
+    nid_t err_count = count_errors(origPullG, orig_start_nid,
+                                   fpga_depths.data(), "fpga", parents);
     if (err_count != 0) return EXIT_FAILURE;
     else /* Success */  std::cout << "Validation success!" << std::endl;
   }
 #else
   {
-    // Get the number of all vertices
-    nid_t start_nid = 0;//pullG.num_nodes / 8;
-    std::vector<Edge> e;
-    for(int i=0;i<edge_list.size();i++){
-      Edge temp;
-      temp.src = edge_list[i].first;
-      temp.dst = edge_list[i].second;
-      e.push_back(temp);
-    }
-    std::vector<Vid> vertices;    
-    // Start partition process
-    int size_of_graph = edge_list.size();
-    for(int i=0;i<size_of_graph;i++){
-      Vid source;
-      Vid dest;
-      source = e[i].src;
-      dest = e[i].dst;
-      vertices.push_back(source);
-      vertices.push_back(dest);
-    }
-    std::sort(vertices.begin(), vertices.end());  
-    for(int i=1;i!=vertices.size();i++){
-      if(vertices[i] == vertices[i-1]){
-        vertices.erase(vertices.begin()+i);
-        i--;
-      }
-    }
-    for(int i=0;i!=vertices.size();i++){
-      vertices[i]=0xFFFFFFFF;
-    }
-    vertices[start_nid] = 0;/*start index*/
-    std::vector<Eid> num_edges(vertices.size(),0);
-    std::vector<Eid> edge_offsets(vertices.size(),0);
-    //edge_offsets.push_back(0);
-    int prev = 0;
-    for(int i=1;i!=size_of_graph;i++){
-      if(e[i].src!=e[i-1].src){
-        edge_offsets[e[i].src]=i;
-        num_edges[e[i-1].src] = i-prev;
-        prev = i;
-      }
+    nid_t orig_start_nid = 0;//pullG.num_nodes / 8;
+    nid_t start_nid = new_ids.empty() ? orig_start_nid : new_ids[orig_start_nid];
+    // Shard vertices into PARTITION_NUM destination intervals of
+    // 2^interval_bits vertices (one Scatter/Gather pair each) and the edges
+    // with them. Each Gather keeps up to MAX_VER of its vertices on-chip.
+    int interval_bits = 0;
+    while ((nid_t(PARTITION_NUM) << interval_bits) < pushG.num_nodes)
+      interval_bits++;
+    const Vid interval_mask = (Vid(1) << interval_bits) - 1;
+    auto shards = shard_by_destination(pushG, PARTITION_NUM, interval_bits);
+    std::array<offset_vec_t, PARTITION_NUM> edge_index;
+    std::array<nid_vec_t, PARTITION_NUM> edges;
+    for (int p = 0; p < PARTITION_NUM; p++) {
+      edge_index[p] = std::move(shards.first[p]);
+      edges[p]      = std::move(shards.second[p]);
+      // Shards without edges still need a non-empty buffer.
+      if (edges[p].empty()) edges[p].push_back(0);
     }
-    num_edges[e[size_of_graph-1].src] = size_of_graph - prev;
-    /*
-    std::cout<<edge_offsets.size()<<std::endl<<std::endl;
-    for(int i=1;i<edge_offsets.size();i++){
-      num_edges.push_back(edge_offsets[i]-edge_offsets[i-1]);
-      std::cout<<edge_offsets[i]-edge_offsets[i-1]<<std::endl;
-    }
-    num_edges.push_back(size_of_graph-edge_offsets[edge_offsets.size()-1]);*/
+    #ifdef PARENTS
+    // Depth and parent of every node (see pack_tree_word).
+    std::array<std::vector<tree_word_t>, PARTITION_NUM> intervals;
+    for (auto &interval : intervals)
+      interval.assign(Vid(1) << interval_bits, INVALID_TREE_WORD);
+    intervals[start_nid >> interval_bits][start_nid & interval_mask] =
+        pack_tree_word(0, start_nid);
+    #else
+    std::array<std::vector<VertexAttr>, PARTITION_NUM> intervals;
+    for (auto &interval : intervals)
+      interval.assign(Vid(1) << interval_bits, 0xFFFFFFFF);
+    intervals[start_nid >> interval_bits][start_nid & interval_mask] = 0;
+    #endif
+    std::vector<Resp> queue(pushG.num_nodes);
+    std::vector<LevelStats> level_stats(pushG.num_nodes + 1);
     std::string bitstream;
     if (const auto bitstream_ptr = getenv("TAPAB")) {
       bitstream = bitstream_ptr;
     }
+    #ifdef PARENTS
+    tapa::invoke(
+        bfs_fpga_edge_parents, bitstream, start_nid, interval_bits,
+        tapa::read_only_mmap<offset_t>(pushG.index),
+        tapa::read_only_mmaps<offset_t, PARTITION_NUM>(edge_index),
+        tapa::read_only_mmaps<nid_t, PARTITION_NUM>(edges),
+        tapa::read_write_mmaps<tree_word_t, PARTITION_NUM>(intervals),
+        tapa::read_write_mmap<Resp>(queue).reinterpret<bits<Resp>>(),
+        tapa::read_write_mmap<LevelStats>(level_stats).reinterpret<bits<LevelStats>>());
+    std::vector<VertexAttr> vertices(pushG.num_nodes);
+    nid_vec_t edge_parents(pushG.num_nodes);
+    for (Vid u = 0; u < vertices.size(); u++) {
+      tree_word_t word = intervals[u >> interval_bits][u & interval_mask];
+      vertices[u]     = tree_depth(word);
+      edge_parents[u] = tree_parent(word);
+    }
+    if (not new_ids.empty())
+      edge_parents = unpermute_parents(edge_parents, new_ids);
+    const nid_t *parents = edge_parents.data();
+    #else
     tapa::invoke(
-        bfs_fpga_edge, bitstream, vertices.size(), start_nid /*start index*/, tapa::read_only_mmap<const Eid>(num_edges),
-        tapa::read_only_mmap<const Eid>(edge_offsets), tapa::read_write_mmap<VertexAttr>(vertices), tapa::read_only_mmap<Edge>(e).reinterpret<bits<Edge>>());
+        bfs_fpga_edge, bitstream, start_nid, interval_bits,
+        tapa::read_only_mmap<offset_t>(pushG.index),
+        tapa::read_only_mmaps<offset_t, PARTITION_NUM>(edge_index),
+        tapa::read_only_mmaps<nid_t, PARTITION_NUM>(edges),
+        tapa::read_write_mmaps<VertexAttr, PARTITION_NUM>(intervals),
+        tapa::read_write_mmap<Resp>(queue).reinterpret<bits<Resp>>(),
+        tapa::read_write_mmap<LevelStats>(level_stats).reinterpret<bits<LevelStats>>());
+    std::vector<VertexAttr> vertices(pushG.num_nodes);
+    for (Vid u = 0; u < vertices.size(); u++)
+      vertices[u] = intervals[u >> interval_bits][u & interval_mask];
+    const nid_t *parents = nullptr;
+    #endif
+    if (not dump_level_stats(level_stats)) return EXIT_FAILURE;
 
     DEBUG(
     if (pushG.num_nodes <= PRINT_MAX_NODES) {
@@ -219,25 +666,13 @@ int main(int argc, char *argv[]) {
       std::cout << std::endl;
     });
     std::cout<<pushG.num_nodes<<std::endl;
-    std::vector<depth_t> validation_depths(pushG.num_nodes, INVALID_DEPTH);
-    bfs_cpu_push(pushG, start_nid, validation_depths);
+    // Unreached vertices hold 0xFFFFFFFF, i.e. INVALID_DEPTH as depth_t.
+    std::vector<depth_t> edge_depths(vertices.begin(), vertices.end());
+    if (not new_ids.empty()) edge_depths = unpermute(edge_depths, new_ids);
 
-    nid_t err_count = 0;
-    for (nid_t u = 0; u < pushG.num_nodes; u++) {
-      if (vertices[u] != validation_depths[u]) {
-        if (err_count < PRINT_MAX_ERRORS) {
-          DEBUG(std::cout << "[error] node " << u << " fpga depth (" 
-                          << vertices[u] << ") != oracle depth ("
-                          << validation_depths[u] << ")" << std::endl);
-        }
-        err_count++;
-      }
-    }
-    if (err_count >= PRINT_MAX_ERRORS) {
-      DEBUG(std::cout << "[error] ... " << std::endl
-                      << "[error] and " << (err_count - PRINT_MAX_ERRORS)
-                      << " more errors" << std::endl);
-    }
+    // Validate on the original graph.
+    nid_t err_count = count_errors(origPullG, orig_start_nid,
+                                   edge_depths.data(), "fpga", parents);
     if (err_count != 0) return EXIT_FAILURE;
     else /* Success */  DEBUG(std::cout << "Validation success!" << std::endl);
   }
@@ -0,0 +1,38 @@
+#include "bfs-session.h"
+
+#include <algorithm>
+#include <tapa.h>
+
+BfsSession::BfsSession(const GraphView &push_g, const std::string &bitstream)
+  : push_g_(push_g), bitstream_(bitstream),
+    level_stats_(push_g.num_nodes + 1),
+    bitmap_spill_(Bitmap::spill_size(push_g.num_nodes)),
+    frontier_spill_(2 * push_g.num_nodes) {}
+
+std::size_t BfsSession::submit(nid_t start) {
+  starts_.push_back(start);
+  return starts_.size() - 1;
+}
+
+std::vector<depth_t> BfsSession::run() {
+  const nid_t num_queries = starts_.size();
+  std::vector<depth_t> depths(std::size_t(num_queries) * push_g_.num_nodes,
+                              INVALID_DEPTH);
+  query_cycles_.assign(num_queries, 0);
+  if (num_queries == 0) return depths;
+  std::fill(level_stats_.begin(), level_stats_.end(), LevelStats{});
+
+  tapa::invoke(
+      bfs_fpga_session, bitstream_,
+      num_queries, push_g_.num_nodes, tapa::read_only_mmap<nid_t>(starts_),
+      tapa::read_only_mmap<offset_t>(push_g_.index),
+      tapa::read_only_mmap<nid_t>(push_g_.neighbors),
+      tapa::read_write_mmap<depth_t>(depths),
+      tapa::write_only_mmap<cycle_t>(query_cycles_),
+      tapa::read_write_mmap<LevelStats>(level_stats_)
+        .reinterpret<bits<LevelStats>>(),
+      tapa::read_write_mmap<Bitmap::tile_word_t>(bitmap_spill_),
+      tapa::read_write_mmap<nid_t>(frontier_spill_));
+  starts_.clear();
+  return depths;
+}
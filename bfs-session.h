@@ -0,0 +1,46 @@
+#ifndef BFS_SESSION_H
+#define BFS_SESSION_H
+
+#include <string>
+#include <vector>
+
+#include "bfs-fpga.h"
+#include "graph.h"
+
+/**
+ * BFS queries against one graph. Queries are submitted and then run as a
+ * batch. A batch is a single bfs_fpga_session invocation, so the graph is
+ * transferred to device memory once per batch instead of once per query,
+ * and the kernel loops over the start nodes. Scratch buffers are allocated
+ * once per session.
+ * The graph arrays must outlive the session.
+ */
+class BfsSession {
+ public:
+  BfsSession(const GraphView &push_g, const std::string &bitstream);
+
+  // Queues a query from start. Returns its position in the next batch.
+  std::size_t submit(nid_t start);
+
+  /**
+   * Runs all queued queries. Returns the depths of query q at
+   * [q * num_nodes, (q + 1) * num_nodes).
+   */
+  std::vector<depth_t> run();
+
+  // Estimated kernel cycles of every query of the last batch.
+  const std::vector<cycle_t> &query_cycles() const { return query_cycles_; }
+  // LevelStats of the last query of the last batch.
+  const std::vector<LevelStats> &level_stats() const { return level_stats_; }
+
+ private:
+  GraphView   push_g_;
+  std::string bitstream_;
+  nid_vec_t   starts_;
+  std::vector<cycle_t>             query_cycles_;
+  std::vector<LevelStats>          level_stats_;
+  std::vector<Bitmap::tile_word_t> bitmap_spill_;
+  std::vector<nid_t>               frontier_spill_;
+};
+
+#endif // BFS_SESSION_H
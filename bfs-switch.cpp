@@ -4,112 +4,276 @@
 #include <assert.h>
 #include <iostream>
 #include "bitmap.h"
+#include "tiled-bitmap.h"
 #include "util.h"
+#include "write-combiner.h"
 
-bool PUSH_OR_PULL = false; // true = PUSH, false = PULL
-
-nid_t nodes_explored = 1;
-
-constexpr nid_t MAX_EPOCHS = 100;
-constexpr nid_t MAX_NODES = 4500;
-enum Mode { push = 0, pull = 1 };
+using word_t = Bitmap::tile_word_t;
+constexpr nid_t WORD_BITS = Bitmap::word_bits<word_t>::value;
+// Bitmap words cached on-chip (loop trip count hint).
+constexpr nid_t MAX_WORDS = Bitmap::NUM_TILES * Bitmap::TILE_WORDS;
 
+// End-of-epoch report of ProcessingElement_switch.
 struct Update {
   nid_t    num_nodes;
   offset_t num_edges_explored;
+  cycle_t  cycles;
 };
 
-void Controller_switch(nid_t start_nid, nid_t num_nodes, nid_t num_edges,
-    tapa::ostream<nid_t> &config_q, tapa::istream<Update> &ir_q
+/**
+ * Direction of the next epoch with the heuristic of Beamer et al.:
+ * push -> pull when the frontier is growing and its out-edges exceed
+ * 1 / alpha of the unexplored edges, pull -> push when it is shrinking and
+ * holds fewer than 1 / beta of the nodes.
+ */
+static Mode next_mode(Mode mode, bool growing, nid_t num_nodes,
+    nid_t frontier_nodes, uint64_t frontier_edges, uint64_t unexplored_edges,
+    int alpha, int beta
+) {
+  if (mode == Mode::push) {
+    if (growing and frontier_edges * alpha > unexplored_edges)
+      return Mode::pull;
+  } else if (not growing and
+             uint64_t(frontier_nodes) * beta < uint64_t(num_nodes)) {
+    return Mode::push;
+  }
+  return mode;
+}
+
+/**
+ * Picks the direction of every epoch (see next_mode).
+ * The frontier size comes from ProcessingElement_switch, its out-degree sum
+ * from DegreeCounter_switch; unexplored edges are the edges left after
+ * subtracting every frontier's out-degree sum.
+ * A new BFS (bfs_switch) sends start_nid to the PE as the first frontier;
+ * a resumed one (bfs_switch_levels) starts from the frontier the host left
+ * in bitmap_spill and sends no start node.
+ * Returns only after the depth writer acknowledged (flushed_q) the setup
+ * and every epoch run, so the kernel never ends with depths in flight.
+ * Parameters:
+ *   - resume      <- resume from the host's frontier instead of start_nid.
+ *   - alpha, beta <- switching thresholds.
+ *   - handoff     <- stop once the frontier shrinks below handoff nodes,
+ *                    leaving the small levels to the host (0 = run to
+ *                    completion).
+ *   - frontier_nodes, prev_frontier_nodes <- size of the first frontier
+ *                    and of the one before it (1 and 0 for a new BFS).
+ *   - frontier_edges   <- out-degree sum of a resumed frontier (0 for a new
+ *                         BFS: the start node's comes from the PE).
+ *   - unexplored_edges <- edges not reached by any frontier yet.
+ *   - level_stats      <- LevelStats of every epoch run.
+ */
+void Controller_switch(bool resume, nid_t start_nid, nid_t num_nodes,
+    int alpha, int beta, nid_t handoff,
+    nid_t frontier_nodes, nid_t prev_frontier_nodes,
+    offset_t frontier_edges_in, offset_t unexplored_edges_in,
+    tapa::ostream<nid_t> &config_q, tapa::istream<Update> &ir_q,
+    tapa::istream<offset_t> &frontier_edges_q, tapa::istream<bool> &flushed_q,
+    tapa::mmap<bits<LevelStats>> level_stats
 ) {
-  config_q.write(start_nid);
+  if (not resume) config_q.write(start_nid);
   config_q.close();
 
-  Update update = {1, num_edges};
-
-  Mode mode = Mode::push;
-  for (nid_t epoch = 0; epoch < MAX_EPOCHS; epoch++) {
-#pragma HLS unroll factor=4
-    /*
-      For each epoch,
-        - Average # of Push traversal edges(PushTr) 
-          = Total edges / Total vertices * Frontier vertices
-        - Average # of Pull traversal edges(PullTr) 
-          = Total edges / Total vertices * Unseen vertices 
-          + Total vertices / Frontier vertices * Seen vertices
-        - 
-        - Hardcode Seen vertices here to be min(#frontier * 3, #remaining nodes / 3)
-                   Unseen vertices = total vertices - traversed - frontier - seen vertices
-      
-      Switching logic: PushTr > PullTr? Pull : Push;
-      - Seen vertices = Next Frontier, 
-      - `update` represents the Frontier for this epoch
-    */
-    nid_t remaining_node = num_nodes - nodes_explored;
-    nid_t Seen = std::min(update.num_nodes * 3, remaining_node / 3);
-    nid_t Unseen =  remaining_node - Seen;
-    int threshold = (int)(num_edges/num_nodes * (update.num_nodes - Unseen) - num_nodes/update.num_nodes * Seen);
-    PUSH_OR_PULL = (threshold > 0 ? false : true); 
-    DEBUG(
-      std::cout << "nodes_explored: " << nodes_explored << std::endl;
-      std::cout << "remaining_node: " << remaining_node << std::endl;
-      std::cout << "update.num_nodes: " << update.num_nodes << std::endl;
-      std::cout << "Seen: " << Seen << std::endl;
-      std::cout << "Unseen: " << Unseen << std::endl;
-      std::cout << "PUSH_OR_PULL: " << PUSH_OR_PULL << std::endl;
-      std::cout << "threshold: " << threshold << std::endl;
-      std::cout << std::endl;
-    );
-    config_q.write(PUSH_OR_PULL ? Mode::push : Mode::pull);
+  // Out-degree of the start node (0 after the empty setup of a resume).
+  offset_t setup_edges      = frontier_edges_q.read();
+  uint64_t frontier_edges   = uint64_t(frontier_edges_in) + setup_edges;
+  uint64_t unexplored_edges = uint64_t(unexplored_edges_in) - setup_edges;
+
+  Mode  mode       = Mode::push; // First epoch is always push.
+  nid_t last_epoch = 0;          // Epochs run.
+  for (nid_t epoch = 0; frontier_nodes != 0 and
+       (frontier_nodes >= handoff or frontier_nodes > prev_frontier_nodes);
+       epoch++) {
+#pragma HLS loop_tripcount max=2048
+    bool growing = frontier_nodes > prev_frontier_nodes;
+    mode = next_mode(mode, growing, num_nodes, frontier_nodes, frontier_edges,
+                     unexplored_edges, alpha, beta);
+    DEBUG(std::cout << "[switch] epoch " << epoch << ": "
+                    << (mode == Mode::push ? "push" : "pull") << ", "
+                    << frontier_nodes << " nodes, " << frontier_edges
+                    << " frontier edges, " << unexplored_edges
+                    << " unexplored edges" << std::endl);
+    config_q.write(mode);
     config_q.close();
 
-    // Update update;
+    Update update;
     TAPA_WHILE_NOT_EOT(ir_q) {
       update = ir_q.read(nullptr);
     }
     ir_q.try_open(); // Reset stream.
+    flushed_q.read(); // Previous epoch (or the setup) is in memory.
+    level_stats[epoch] = tapa::bit_cast<bits<LevelStats>>(LevelStats{
+        uint64_t(frontier_nodes), uint64_t(update.num_edges_explored),
+        uint64_t(update.num_nodes), uint64_t(mode), update.cycles});
     DEBUG(
     std::cout << "Number nodes updated:  " << update.num_nodes << std::endl
               << "Number edges explored: " << update.num_edges_explored 
               << std::endl);
 
-    // If no updates, the kernel is done!
-    if (update.num_nodes == 0) break;
+    prev_frontier_nodes = frontier_nodes;
+    frontier_nodes      = update.num_nodes;
+    frontier_edges      = frontier_edges_q.read();
+    unexplored_edges   -= frontier_edges;
+    last_epoch          = epoch + 1;
   }
+  flushed_q.read(); // So is the last one.
+  // End of the records (see level-stats.h).
+  level_stats[last_epoch] = tapa::bit_cast<bits<LevelStats>>(LevelStats{});
 }
 
+/**
+ * Sums the out-degrees of the nodes ProcessingElement_switch sends on
+ * degree_q (the starting node, then the nodes discovered by each epoch) and
+ * reports the sum to Controller_switch when the stream closes.
+ * degree_index is a second view of the push index so these lookups don't
+ * disturb NeighborReader_switch.
+ */
+void DegreeCounter_switch(tapa::istream<nid_t> &degree_q,
+    tapa::ostream<offset_t> &frontier_edges_q,
+    tapa::mmap<offset_t> degree_index
+) {
+  for (;;) {
+#pragma HLS loop_tripcount max=2048
+    offset_t frontier_edges = 0;
+    TAPA_WHILE_NOT_EOT(degree_q) {
+#pragma HLS pipeline II=1
+      auto u = degree_q.read(nullptr);
+      frontier_edges += degree_index[u + 1] - degree_index[u];
+    }
+    degree_q.try_open(); // Reset stream.
+
+    frontier_edges_q.write(frontier_edges);
+  }
+}
+
+// Neighbor list request from ProcessingElement_switch (also used to cancel
+// the pull list of u requested in the same epoch).
+struct NeighborRequest {
+  nid_t u;
+  bool  is_push;
+  nid_t epoch;
+};
+
+// One neighbor v of requested node u.
+struct Neighbor {
+  nid_t u;
+  nid_t v;
+};
+
+constexpr int MAX_IN_FLIGHT = 16; // Outstanding neighbor list requests.
+
+/**
+ * Streams the neighbor list of every requested node, closing the stream
+ * after each list. Index and neighbor arrays are read a whole burst_t
+ * (BURST_ENTRIES entries) at a time and the last index word of each
+ * direction is kept, so sequential requests (pull scans) reuse it.
+ * A pull list is cut short when a cancel for the same node and epoch shows
+ * up on cancel_q; push lists are never cut, and cancels that arrive after
+ * their list are dropped (they don't match any later request).
+ */
+void NeighborReader_switch(
+    tapa::istream<NeighborRequest> &req_q, tapa::ostream<Neighbor> &nbr_q,
+    tapa::istream<NeighborRequest> &cancel_q,
+    tapa::mmap<burst_t> push_index, tapa::mmap<burst_t> push_neighbors,
+    tapa::mmap<burst_t> pull_index, tapa::mmap<burst_t> pull_neighbors
+) {
+  burst_t index_word[2];     // Cached index word (push, pull).
+  nid_t   index_tag[2] = {-1, -1};
+
+  for (;;) {
+#pragma HLS loop_tripcount max=2048
+    NeighborRequest req = req_q.read();
+    const int dir = req.is_push ? 0 : 1;
+
+    offset_t range[2];
+    for (int i = 0; i < 2; i++) {
+      nid_t n   = req.u + i;
+      nid_t tag = n / BURST_ENTRIES;
+      if (index_tag[dir] != tag) {
+        index_word[dir] = req.is_push ? push_index[tag] : pull_index[tag];
+        index_tag[dir]  = tag;
+      }
+      range[i] = burst_entry(index_word[dir], n % BURST_ENTRIES);
+    }
+
+    bool cancelled = false;
+    for (offset_t off = range[0]; off < range[1] and not cancelled;) {
+#pragma HLS loop_tripcount max=64
+      burst_t word = req.is_push ? push_neighbors[off / BURST_ENTRIES]
+                                 : pull_neighbors[off / BURST_ENTRIES];
+      for (int i = off % BURST_ENTRIES; 
+           i < BURST_ENTRIES and off < range[1]; i++, off++) {
+#pragma HLS pipeline II=1
+        nbr_q.write({req.u, burst_entry(word, i)});
+      }
+
+      // Drop stale cancels of earlier lists.
+      NeighborRequest c;
+      while (cancel_q.try_read(c)) {
+        if (not req.is_push and c.u == req.u and c.epoch == req.epoch)
+          cancelled = true;
+      }
+    }
+    nbr_q.close(); // End of list.
+  }
+}
+
+/**
+ * Visits frontier nodes (push) or unexplored nodes (pull) a bitmap word at a
+ * time. Neighbor lists come from NeighborReader_switch; requests run up to
+ * MAX_IN_FLIGHT nodes ahead of the list being processed, so memory latency
+ * overlaps with the bitmap checks.
+ * Every discovered node goes to DepthWriter_switch (update_q, with the
+ * frontier node it was reached from) and
+ * DegreeCounter_switch (degree_q); the number of them is sent to
+ * Controller_switch (ir_q) at the end of each epoch.
+ */
 void ProcessingElement_switch(
-    nid_t num_nodes, tapa::istream<nid_t> &config_q,
-    tapa::ostream<nid_t> &update_q, tapa::ostream<Update> &ir_q,
-    tapa::mmap<offset_t> push_index, tapa::mmap<nid_t> push_neighbors,
-    tapa::mmap<offset_t> pull_index, tapa::mmap<nid_t> pull_neighbors,
-    tapa::mmap<depth_t> depth
+    nid_t num_nodes, bool resume, tapa::istream<nid_t> &config_q,
+    tapa::ostream<NodeUpdate> &update_q, tapa::ostream<Update> &ir_q,
+    tapa::ostream<nid_t> &degree_q,
+    tapa::ostream<NeighborRequest> &req_q, tapa::istream<Neighbor> &nbr_q,
+    tapa::ostream<NeighborRequest> &cancel_q,
+    tapa::mmap<word_t> bitmap_spill
 ) {
-  Bitmap::bitmap_t frontier[Bitmap::bitmap_size(MAX_NODES)];
-  Bitmap::bitmap_t next_frontier[Bitmap::bitmap_size(MAX_NODES)];
-  Bitmap::bitmap_t explored[Bitmap::bitmap_size(MAX_NODES)];
-  for (nid_t i = 0; i < Bitmap::bitmap_size(MAX_NODES); i++)
-    frontier[i] = next_frontier[i] = explored[i] = 0;
+  // Bitmaps are tiled over bitmap_spill: explored first, then the two
+  // frontier planes. Frontier plane cur holds the current frontier.
+  // A resumed BFS (bfs_switch_levels) starts from the bitmaps in
+  // bitmap_spill instead of clearing them.
+  const nid_t  num_words   = Bitmap::bitmap_size<word_t>(num_nodes);
+  const size_t plane_words = Bitmap::spill_size(num_nodes);
+  const size_t plane_bits  = plane_words * WORD_BITS;
+  Bitmap::TiledBitmap explored;
+  Bitmap::TiledBitmap frontiers;
+  if (resume) {
+    explored.attach(0, num_nodes);
+    frontiers.attach(plane_words, 2 * plane_bits);
+  } else {
+    explored.reset(bitmap_spill, 0, num_nodes);
+    frontiers.reset(bitmap_spill, plane_words, 2 * plane_bits);
+  }
+  int cur = 0;
 
   // Setup starting node.
   TAPA_WHILE_NOT_EOT(config_q) {
     nid_t u = config_q.read(nullptr);
-    Bitmap::set_bit(frontier, u);
-    Bitmap::set_bit(explored, u);
-    update_q.write(u); // Send depth update for starting node.
+    frontiers.set(bitmap_spill, u);
+    explored.set(bitmap_spill, u);
+    update_q.write({u, u}); // Send depth update for starting node.
+    degree_q.write(u);
   }
   config_q.try_open(); // Reset stream.
   update_q.close(); // End update stream.
+  degree_q.close();
 
-  // First epoch is always push.
-  bool is_push = PUSH_OR_PULL;
+  bool is_push = true;
   nid_t    num_nodes_updated;
   offset_t num_edges_explored;
+  cycle_t  cycles;
 
-  for (;;) {
+  for (nid_t epoch = 0;; epoch++) {
 #pragma HLS loop_tripcount max=2048
     num_nodes_updated = 0;
-    num_edges_explored = 0;
 
     // Await configuration information.
     TAPA_WHILE_NOT_EOT(config_q) {
@@ -120,94 +284,213 @@ void ProcessingElement_switch(
     }
     config_q.try_open(); // Reset stream.
     DEBUG(std::cout << "Next epoch" << std::endl);
-    
-    if (is_push) { // PUSH
-      for (nid_t u = 0; u < num_nodes; u++) {
-#pragma HLS pipeline II=1
-        if (Bitmap::get_bit(frontier, u)) {
-          DEBUG(std::cout << "[push] node " << u << ": ");
-          for (offset_t off = push_index[u]; off < push_index[u + 1]; off++) {
+    num_edges_explored = 0;
+    cycles             = 0;
+
+    nid_t  w         = 0;     // Next bitmap word to load.
+    word_t word      = 0;     // Nodes of word w - 1 not requested yet.
+    bool   issuing   = true;
+    nid_t  in_flight = 0;     // Requested lists not fully processed.
+    bool   found     = false; // Parent found for the current pull list.
+    expand:
+    while (issuing or in_flight != 0) {
 #pragma HLS pipeline II=1
-            nid_t v = push_neighbors[off];
-            if (not Bitmap::get_bit(explored, v)) { // If child not explored.
-              DEBUG(std::cout << v << " ");
-              Bitmap::set_bit(explored, v);
-              Bitmap::set_bit(next_frontier, v);
-              update_q.write(v);
-              num_nodes_updated++;
-              nodes_explored++;
-            }
-          }          
-          DEBUG(std::cout << std::endl);
-          num_edges_explored += push_index[u + 1] - push_index[u];
+      cycles++;
+      // Request the next node's neighbor list.
+      if (issuing and word == 0) {
+        if (w == num_words) {
+          issuing = false;
+        } else if (is_push) { // Frontier nodes.
+          word = frontiers.word(bitmap_spill, cur * plane_words + w);
+          w++;
+        } else {              // Unexplored nodes.
+          word = ~explored.word(bitmap_spill, w);
+          if (w == num_words - 1 and num_nodes % WORD_BITS != 0)
+            word &= ~word_t(0) >> (WORD_BITS - num_nodes % WORD_BITS); // Tail.
+          w++;
+        }
+      } else if (issuing) {
+        nid_t u = (w - 1) * WORD_BITS + Bitmap::lowest_bit(word);
+        if (req_q.try_write({u, is_push, epoch})) {
+          Bitmap::clear_lowest_bit(word);
+          in_flight++;
         }
       }
-    } else { // PULL
-      num_edges_explored = 1;
-      for (nid_t v = 0; v < num_nodes; v++) {
-#pragma HLS pipeline II=1
-        if (not Bitmap::get_bit(explored, v)) { // If not explored.
-          for (offset_t off = pull_index[v]; off < pull_index[v + 1]; off++) {
-#pragma HLS pipeline II=1
-            nid_t u = pull_neighbors[off];
-            if (Bitmap::get_bit(frontier, u)) {
-              Bitmap::set_bit(explored, v);
-              Bitmap::set_bit(next_frontier, v);
-              update_q.write(v);
-              num_nodes_updated++;
-              nodes_explored++;
-              DEBUG(std::cout << "[pull] node " << v << ": " << u << std::endl);
-              break;
-            }
-          }
+
+      // Process one neighbor.
+      bool valid;
+      bool is_eot = nbr_q.eot(valid);
+      if (not valid) continue;
+      if (is_eot) { // End of list.
+        nbr_q.open();
+        in_flight--;
+        found = false;
+        continue;
+      }
+      Neighbor n = nbr_q.read(nullptr);
+      num_edges_explored++;
+      if (is_push) { // PUSH: n.v is a child of frontier node n.u.
+        if (not explored.get(bitmap_spill, n.v)) { // If child not explored.
+          DEBUG(std::cout << "[push] node " << n.u << ": " << n.v << std::endl);
+          explored.set(bitmap_spill, n.v);
+          frontiers.set(bitmap_spill, (cur ^ 1) * plane_bits + n.v);
+          update_q.write({n.v, n.u});
+          degree_q.write(n.v);
+          num_nodes_updated++;
         }
+      } else if (not found and // PULL: n.v is a parent of unexplored n.u.
+                 frontiers.get(bitmap_spill, cur * plane_bits + n.v)) {
+        found = true;
+        explored.set(bitmap_spill, n.u);
+        frontiers.set(bitmap_spill, (cur ^ 1) * plane_bits + n.u);
+        update_q.write({n.u, n.v});
+        degree_q.write(n.u);
+        num_nodes_updated++;
+        // Best effort, the rest is skipped anyway.
+        cancel_q.try_write({n.u, false, epoch});
+        DEBUG(std::cout << "[pull] node " << n.u << ": " << n.v << std::endl);
       }
     }
     update_q.close(); // Inform DepthWriter_switch the current epoch has ended.
+    degree_q.close(); // Inform DegreeCounter_switch as well.
 
-    // Swap frontiers.
-    std::swap(frontier, next_frontier);
-    std::cout << "next frontier update" << std::endl;
-    for (size_t i = 0; i < Bitmap::bitmap_size(MAX_NODES); i++)
-      next_frontier[i] = 0;
+    // Swap frontiers and clear the new next frontier.
+    frontiers.clear(bitmap_spill, cur * plane_words, plane_words);
+    cur ^= 1;
 
     // Send update information to controller.
-    ir_q.write({num_nodes_updated, num_edges_explored});
+    ir_q.write({num_nodes_updated, num_edges_explored, cycles});
     ir_q.close();
   }
 }
 
-void DepthWriter_switch(tapa::istream<nid_t> &update_q, tapa::mmap<depth_t> depth) {
-  depth_t cur_depth = 0;
-  for (;;) {
-#pragma HLS loop_tripcount max=2048
-    TAPA_WHILE_NOT_EOT(update_q) {
-      auto u = update_q.read(nullptr);
-      //DEBUG(std::cout << "Updating node " << u 
-                      //<< " with depth " << cur_depth << std::endl);
-
-      depth[u] = cur_depth;
-    }
-    update_q.try_open(); // Reset stream.
+// Writes the depth of every discovered node (see write_epochs); the setup
+// epoch (start node) has depth start_depth. Every epoch is acknowledged on
+// flushed_q once it is in memory. With until_empty it returns after the
+// last epoch of a complete BFS (which discovers nothing) and is invoked
+// joined; bfs_switch_levels can stop at a non-empty epoch, so its writer
+// runs detached and Controller_switch waits for the acknowledgements.
+void DepthWriter_switch(nid_t num_nodes, depth_t start_depth,
+    bool until_empty,
+    tapa::istream<NodeUpdate> &update_q, tapa::ostream<bool> &flushed_q,
+    tapa::mmap<depth_t> depth
+) {
+  write_epochs(update_q, depth, 0, num_nodes, start_depth, until_empty,
+      [](depth_t d, const NodeUpdate &) { return d; },
+      [&flushed_q] { flushed_q.write(true); });
+}
 
-    cur_depth++; // Next depth.
-  }
+// DepthWriter_switch writing depth and parent packed in one word (see
+// pack_tree_word).
+void TreeWriter_switch(nid_t num_nodes, depth_t start_depth,
+    bool until_empty,
+    tapa::istream<NodeUpdate> &update_q, tapa::ostream<bool> &flushed_q,
+    tapa::mmap<tree_word_t> tree
+) {
+  write_epochs(update_q, tree, 0, num_nodes, start_depth, until_empty,
+      [](depth_t d, const NodeUpdate &update) {
+        return pack_tree_word(d, update.parent);
+      },
+      [&flushed_q] { flushed_q.write(true); });
 }
 
 void bfs_switch(
-    nid_t start_nid, nid_t num_nodes, nid_t num_edges,
-    tapa::mmap<offset_t> push_index, tapa::mmap<nid_t> push_neighbors,
-    tapa::mmap<offset_t> pull_index, tapa::mmap<nid_t> pull_neighbors,
-    tapa::mmap<depth_t> depth
+    nid_t start_nid, nid_t num_nodes, nid_t num_edges, int alpha, int beta,
+    tapa::mmap<burst_t> push_index, tapa::mmap<burst_t> push_neighbors,
+    tapa::mmap<burst_t> pull_index, tapa::mmap<burst_t> pull_neighbors,
+    tapa::mmap<offset_t> degree_index,
+    tapa::mmap<depth_t> depth, tapa::mmap<Bitmap::tile_word_t> bitmap_spill,
+    tapa::mmap<bits<LevelStats>> level_stats
+) {
+  tapa::stream<nid_t, 1>  config_q;
+  tapa::stream<NodeUpdate, 8> update_q;
+  tapa::stream<Update, 1> ir_q;
+  tapa::stream<nid_t, 8>  degree_q;
+  tapa::stream<offset_t, 2> frontier_edges_q;
+  tapa::stream<NeighborRequest, MAX_IN_FLIGHT> req_q;
+  tapa::stream<Neighbor, 2 * BURST_ENTRIES>    nbr_q;
+  tapa::stream<NeighborRequest, 4> cancel_q;
+  tapa::stream<bool, 2>   flushed_q;
+
+  tapa::task()
+    .invoke(Controller_switch, false, start_nid, num_nodes, alpha, beta,
+        0, 1, 0, 0, num_edges, config_q, ir_q, frontier_edges_q, flushed_q,
+        level_stats)
+    .invoke<tapa::detach>(ProcessingElement_switch, num_nodes, false,
+        config_q, update_q, ir_q, degree_q, req_q, nbr_q, cancel_q,
+        bitmap_spill)
+    .invoke<tapa::detach>(DegreeCounter_switch, degree_q, frontier_edges_q,
+        degree_index)
+    .invoke<tapa::detach>(NeighborReader_switch, req_q, nbr_q, cancel_q,
+        push_index, push_neighbors, pull_index, pull_neighbors)
+    .invoke(DepthWriter_switch, num_nodes, 0, true, update_q, flushed_q,
+        depth);
+}
+
+void bfs_switch_parents(
+    nid_t start_nid, nid_t num_nodes, nid_t num_edges, int alpha, int beta,
+    tapa::mmap<burst_t> push_index, tapa::mmap<burst_t> push_neighbors,
+    tapa::mmap<burst_t> pull_index, tapa::mmap<burst_t> pull_neighbors,
+    tapa::mmap<offset_t> degree_index,
+    tapa::mmap<tree_word_t> tree, tapa::mmap<Bitmap::tile_word_t> bitmap_spill,
+    tapa::mmap<bits<LevelStats>> level_stats
+) {
+  tapa::stream<nid_t, 1>  config_q;
+  tapa::stream<NodeUpdate, 8> update_q;
+  tapa::stream<Update, 1> ir_q;
+  tapa::stream<nid_t, 8>  degree_q;
+  tapa::stream<offset_t, 2> frontier_edges_q;
+  tapa::stream<NeighborRequest, MAX_IN_FLIGHT> req_q;
+  tapa::stream<Neighbor, 2 * BURST_ENTRIES>    nbr_q;
+  tapa::stream<NeighborRequest, 4> cancel_q;
+  tapa::stream<bool, 2>   flushed_q;
+
+  tapa::task()
+    .invoke(Controller_switch, false, start_nid, num_nodes, alpha, beta,
+        0, 1, 0, 0, num_edges, config_q, ir_q, frontier_edges_q, flushed_q,
+        level_stats)
+    .invoke<tapa::detach>(ProcessingElement_switch, num_nodes, false,
+        config_q, update_q, ir_q, degree_q, req_q, nbr_q, cancel_q,
+        bitmap_spill)
+    .invoke<tapa::detach>(DegreeCounter_switch, degree_q, frontier_edges_q,
+        degree_index)
+    .invoke<tapa::detach>(NeighborReader_switch, req_q, nbr_q, cancel_q,
+        push_index, push_neighbors, pull_index, pull_neighbors)
+    .invoke(TreeWriter_switch, num_nodes, 0, true, update_q, flushed_q,
+        tree);
+}
+
+void bfs_switch_levels(
+    nid_t num_nodes, int alpha, int beta, nid_t handoff,
+    depth_t frontier_depth, nid_t frontier_nodes, nid_t prev_frontier_nodes,
+    offset_t frontier_edges, offset_t unexplored_edges,
+    tapa::mmap<burst_t> push_index, tapa::mmap<burst_t> push_neighbors,
+    tapa::mmap<burst_t> pull_index, tapa::mmap<burst_t> pull_neighbors,
+    tapa::mmap<offset_t> degree_index,
+    tapa::mmap<depth_t> depth, tapa::mmap<Bitmap::tile_word_t> bitmap_spill,
+    tapa::mmap<bits<LevelStats>> level_stats
 ) {
-  assert(num_nodes <= MAX_NODES);
   tapa::stream<nid_t, 1>  config_q;
-  tapa::stream<nid_t, 8>  update_q;
+  tapa::stream<NodeUpdate, 8> update_q;
   tapa::stream<Update, 1> ir_q;
+  tapa::stream<nid_t, 8>  degree_q;
+  tapa::stream<offset_t, 2> frontier_edges_q;
+  tapa::stream<NeighborRequest, MAX_IN_FLIGHT> req_q;
+  tapa::stream<Neighbor, 2 * BURST_ENTRIES>    nbr_q;
+  tapa::stream<NeighborRequest, 4> cancel_q;
+  tapa::stream<bool, 2>   flushed_q;
 
   tapa::task()
-    .invoke(Controller_switch, start_nid, num_nodes, num_edges, config_q, ir_q)
-    .invoke<tapa::detach>(ProcessingElement_switch, num_nodes, config_q, update_q, 
-        ir_q, push_index, push_neighbors, pull_index, pull_neighbors, depth)
-    .invoke<tapa::detach>(DepthWriter_switch, update_q, depth);
+    .invoke(Controller_switch, true, 0, num_nodes, alpha, beta, handoff,
+        frontier_nodes, prev_frontier_nodes, frontier_edges, unexplored_edges,
+        config_q, ir_q, frontier_edges_q, flushed_q, level_stats)
+    .invoke<tapa::detach>(ProcessingElement_switch, num_nodes, true,
+        config_q, update_q, ir_q, degree_q, req_q, nbr_q, cancel_q,
+        bitmap_spill)
+    .invoke<tapa::detach>(DegreeCounter_switch, degree_q, frontier_edges_q,
+        degree_index)
+    .invoke<tapa::detach>(NeighborReader_switch, req_q, nbr_q, cancel_q,
+        push_index, push_neighbors, pull_index, pull_neighbors)
+    .invoke<tapa::detach>(DepthWriter_switch, num_nodes,
+        frontier_depth, false, update_q, flushed_q, depth);
 }
\ No newline at end of file
@@ -0,0 +1,108 @@
+#include "bfs-validate.h"
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+// Edges checked per thread at least (smaller graphs use fewer threads).
+constexpr offset_t MIN_EDGES_PER_THREAD = 1 << 16;
+
+const char *bfs_error_name(BfsError error) {
+  switch (error) {
+    case BfsError::none:   return "none";
+    case BfsError::root:   return "root not at depth 0";
+    case BfsError::depth:  return "bad depth";
+    case BfsError::edge:   return "edge spans more than one level";
+    case BfsError::parent: return "no parent at depth - 1";
+  }
+  return "unknown";
+}
+
+// Check failed by node v (see validate_bfs); counts reached in-edges.
+static BfsError check_node(const GraphView &pull_g, nid_t root,
+    const depth_t *depths, const nid_t *parents, nid_t v, offset_t *num_edges
+) {
+  const depth_t depth = depths[v];
+  if (depth < INVALID_DEPTH or depth >= pull_g.num_nodes)
+    return BfsError::depth;
+  if (v == root and (depth != 0 or (parents and parents[v] != root)))
+    return BfsError::root;
+  if (v != root and depth == 0) return BfsError::depth;
+  // Parent to look for among the in-neighbors (any at depth - 1 if none).
+  const nid_t parent = parents ? parents[v] : INVALID_NODE;
+  if (depth == INVALID_DEPTH and parents and parent != INVALID_NODE)
+    return BfsError::parent;
+
+  BfsError error      = BfsError::none;
+  bool     has_parent = false;
+  for (offset_t off = pull_g.index[v]; off < pull_g.index[v + 1]; off++) {
+    const nid_t   u       = pull_g.neighbors[off];
+    const depth_t u_depth = depths[u];
+    if (u_depth < 0) continue; // Unreached (or flagged on its own).
+    (*num_edges)++;
+    if (depth == INVALID_DEPTH or depth > u_depth + 1)
+      error = BfsError::edge;
+    has_parent = has_parent or
+      (u_depth == depth - 1 and (not parents or u == parent));
+  }
+  if (error == BfsError::none and depth > 0 and not has_parent)
+    error = BfsError::parent;
+  return error;
+}
+
+BfsValidation validate_bfs(const GraphView &pull_g, nid_t root,
+    const depth_t *depths, int threads, const nid_t *parents
+) {
+  const nid_t num_nodes = pull_g.num_nodes;
+  BfsValidation result;
+  if (root < 0 or root >= num_nodes) {
+    result.num_errors  = 1;
+    result.first_error = BfsError::root;
+    return result;
+  }
+
+  if (threads <= 0)
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  threads = std::max<offset_t>(1,
+      std::min<offset_t>(threads, pull_g.num_edges / MIN_EDGES_PER_THREAD));
+
+  // Node ranges with about the same number of in-edges each.
+  std::vector<nid_t> bounds(threads + 1, num_nodes);
+  bounds[0] = 0;
+  for (int t = 1; t < threads; t++) {
+    offset_t edge = int64_t(pull_g.num_edges) * t / threads;
+    bounds[t] = std::upper_bound(pull_g.index.begin(),
+                                 pull_g.index.begin() + num_nodes, edge)
+                - pull_g.index.begin() - 1;
+  }
+
+  std::vector<BfsValidation> partial(threads);
+  auto check = [&](int t) {
+    auto &part = partial[t];
+    for (nid_t v = bounds[t]; v < bounds[t + 1]; v++) {
+      BfsError error = check_node(pull_g, root, depths, parents, v,
+                                  &part.num_edges);
+      if (error == BfsError::none) continue;
+      if (part.num_errors++ == 0) {
+        part.first_node  = v;
+        part.first_error = error;
+      }
+    }
+  };
+  std::vector<std::thread> workers;
+  for (int t = 1; t < threads; t++) workers.emplace_back(check, t);
+  check(0);
+  for (auto &worker : workers) worker.join();
+
+  // Ranges are in node order, so the first range with errors has the
+  // lowest failing node.
+  for (const auto &part : partial) {
+    if (result.num_errors == 0 and part.num_errors != 0) {
+      result.first_node  = part.first_node;
+      result.first_error = part.first_error;
+    }
+    result.num_errors += part.num_errors;
+    result.num_edges  += part.num_edges;
+  }
+  return result;
+}
@@ -0,0 +1,46 @@
+#ifndef BFS_VALIDATE_H
+#define BFS_VALIDATE_H
+
+#include "graph.h"
+
+// Graph500 check a node of a BFS result fails (see validate_bfs).
+enum class BfsError {
+  none,
+  root,   // The root is not at depth 0.
+  depth,  // Depth out of range, or a node other than the root at depth 0.
+  edge,   // An in-edge from a reached node spans more than one level (or
+          // the node is unreached).
+  parent, // No in-neighbor at depth - 1 (or the given parent is not one).
+};
+
+// Human-readable name of error.
+const char *bfs_error_name(BfsError error);
+
+struct BfsValidation {
+  nid_t    num_errors  = 0;  // Nodes failing a check.
+  nid_t    first_node  = -1; // Lowest such node, and the check it fails.
+  BfsError first_error = BfsError::none;
+  offset_t num_edges   = 0;  // Edges out of reached nodes (traversed edges).
+};
+
+/**
+ * Checks a BFS result against the Graph500 invariants in one parallel pass
+ * over the in-edges of every node, without a reference traversal:
+ *   - the root has depth 0;
+ *   - every edge (u, v) with u reached has v reached and
+ *     depth[v] <= depth[u] + 1;
+ *   - every reached node but the root has an in-neighbor at depth - 1;
+ *   - every other node is INVALID_DEPTH.
+ * With parents, the parent of every reached node must be such an
+ * in-neighbor (the root its own parent) and other nodes INVALID_NODE.
+ * Parameters:
+ *   - pull_g  <- pull graph of the traversed (push) graph.
+ *   - root    <- start node ID.
+ *   - depths  <- pull_g.num_nodes depths to check.
+ *   - threads <- number of worker threads (0 = hardware concurrency).
+ *   - parents <- (optional) pull_g.num_nodes parents to check.
+ */
+BfsValidation validate_bfs(const GraphView &pull_g, nid_t root,
+    const depth_t *depths, int threads = 0, const nid_t *parents = nullptr);
+
+#endif // BFS_VALIDATE_H
@@ -2,31 +2,181 @@
 #define BITMAP_H
 
 #include <cstdint>
+#include <ap_int.h>
 
 namespace Bitmap {
 
 using std::size_t;
 
-using bitmap_t = char; // bitmap element type.
-constexpr size_t data_size = sizeof(bitmap_t) * 8;
+using bitmap_t      = uint64_t;     // bitmap element type (CPU).
+using wide_bitmap_t = ap_uint<512>; // bitmap element type (HLS, one AXI beat).
 
-// Computes the number of bitmap_t to satisfy a bitmap of number_of_elements.
+// Number of bits in one bitmap element.
+template <typename Word>
+struct word_bits { static constexpr size_t value = sizeof(Word) * 8; };
+template <int W>
+struct word_bits<ap_uint<W>> { static constexpr size_t value = W; };
+
+constexpr size_t data_size = word_bits<bitmap_t>::value;
+
+// Computes the number of Word to satisfy a bitmap of number_of_elements.
+template <typename Word = bitmap_t>
 constexpr size_t bitmap_size(size_t number_of_elements) {
-  return (number_of_elements + data_size - 1) / data_size;
+  return (number_of_elements + word_bits<Word>::value - 1)
+         / word_bits<Word>::value;
 }
 
-inline size_t data_offset(size_t n) { return n / data_size; }
-inline size_t bit_offset(size_t n) { return n & (data_size - 1); }
+template <typename Word = bitmap_t>
+inline size_t data_offset(size_t n) { return n / word_bits<Word>::value; }
+template <typename Word = bitmap_t>
+inline size_t bit_offset(size_t n) { return n & (word_bits<Word>::value - 1); }
 
 // Get bit at position n.
+template <typename Word>
 inline
-bool get_bit(const bitmap_t * const bitmap, size_t n) {
-  return bitmap[data_offset(n)] >> bit_offset(n) & static_cast<bitmap_t>(1);
+bool get_bit(const Word * const bitmap, size_t n) {
+  return ((bitmap[data_offset<Word>(n)] >> bit_offset<Word>(n))
+          & static_cast<Word>(1)) != 0;
 }
 // Set bit at position n to be 1.
+template <typename Word>
+inline
+void set_bit(Word * const bitmap, size_t n) {
+  bitmap[data_offset<Word>(n)] |= static_cast<Word>(1) << bit_offset<Word>(n);
+}
+
+// Number of set bits in a single element.
+template <typename Word>
+inline
+int popcount_word(Word word) {
+  return __builtin_popcountll(static_cast<unsigned long long>(word));
+}
+template <int W>
+inline
+int popcount_word(const ap_uint<W> &word) {
+  int count = 0;
+  for (int i = 0; i < W; i++) {
+#pragma HLS unroll
+    count += word[i];
+  }
+  return count;
+}
+
+// Position of the lowest set bit of a non-zero element.
+template <typename Word>
+inline
+int lowest_bit(Word word) {
+  return __builtin_ctzll(static_cast<unsigned long long>(word));
+}
+template <int W>
+inline
+int lowest_bit(const ap_uint<W> &word) {
+  int pos = W;
+  for (int i = W - 1; i >= 0; i--) {
+#pragma HLS unroll
+    if (word[i]) pos = i;
+  }
+  return pos;
+}
+
+// Clear the lowest set bit of an element.
+template <typename Word>
+inline
+void clear_lowest_bit(Word &word) { word &= word - 1; }
+template <int W>
+inline
+void clear_lowest_bit(ap_uint<W> &word) { word[lowest_bit(word)] = 0; }
+
+/*
+ * Bulk operations. These work a whole element at a time; num_words is the
+ * bitmap length in elements (i.e., bitmap_size<Word>(number_of_elements)).
+ */
+
+// Set every bit to 0.
+template <typename Word>
+inline
+void clear(Word * const bitmap, size_t num_words) {
+  for (size_t i = 0; i < num_words; i++) {
+#pragma HLS pipeline II=1
+    bitmap[i] = 0;
+  }
+}
+
+// Number of set bits.
+template <typename Word>
+inline
+size_t popcount(const Word * const bitmap, size_t num_words) {
+  size_t count = 0;
+  for (size_t i = 0; i < num_words; i++) count += popcount_word(bitmap[i]);
+  return count;
+}
+
+// dst = a & ~b.
+template <typename Word>
+inline
+void and_not(Word * const dst, const Word * const a, const Word * const b,
+    size_t num_words
+) {
+  for (size_t i = 0; i < num_words; i++) {
+#pragma HLS pipeline II=1
+    dst[i] = a[i] & ~b[i];
+  }
+}
+
+// dst |= src.
+template <typename Word>
+inline
+void or_into(Word * const dst, const Word * const src, size_t num_words) {
+  for (size_t i = 0; i < num_words; i++) {
+#pragma HLS pipeline II=1
+    dst[i] |= src[i];
+  }
+}
+
+// Position of the first set bit at or after n, or num_bits if there is none.
+template <typename Word>
+inline
+size_t find_next(const Word * const bitmap, size_t num_bits, size_t n) {
+  constexpr size_t bits = word_bits<Word>::value;
+  if (n >= num_bits) return num_bits;
+
+  size_t i    = data_offset<Word>(n);
+  Word   word = bitmap[i] >> bit_offset<Word>(n) << bit_offset<Word>(n);
+  const size_t num_words = bitmap_size<Word>(num_bits);
+  while (word == 0) { // Skip empty elements.
+    if (++i == num_words) return num_bits;
+    word = bitmap[i];
+  }
+  size_t pos = i * bits + lowest_bit(word);
+  return pos < num_bits ? pos : num_bits;
+}
+
+// Calls fn(n) for every set bit n < num_bits in ascending order.
+template <typename Word, typename Fn>
+inline
+void for_each(const Word * const bitmap, size_t num_bits, Fn fn) {
+  constexpr size_t bits = word_bits<Word>::value;
+  const size_t num_words = bitmap_size<Word>(num_bits);
+  for (size_t i = 0; i < num_words; i++) {
+    Word word = bitmap[i];
+    while (word != 0) {
+      size_t pos = i * bits + lowest_bit(word);
+      if (pos >= num_bits) break;
+      fn(pos);
+      clear_lowest_bit(word);
+    }
+  }
+}
+
+// Atomically set bit at position n; returns whether it was already set.
+// Only for integral elements (multi-threaded CPU code).
+template <typename Word>
 inline
-void set_bit(bitmap_t * const bitmap, size_t n) {
-  bitmap[data_offset(n)] |= static_cast<bitmap_t>(1) << bit_offset(n);
+bool test_and_set(Word * const bitmap, size_t n) {
+  const Word mask = static_cast<Word>(1) << bit_offset<Word>(n);
+  Word &word = bitmap[data_offset<Word>(n)];
+  if (__atomic_load_n(&word, __ATOMIC_RELAXED) & mask) return true;
+  return __atomic_fetch_or(&word, mask, __ATOMIC_RELAXED) & mask;
 }
 
 } // namespace Bitmap
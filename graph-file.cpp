@@ -0,0 +1,160 @@
+#include "graph-file.h"
+
+#include <cstddef>
+#include <fstream>
+#include <iostream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// FNV-1a hash of the header fields before the checksum.
+static uint64_t header_checksum(const GraphFileHeader &header) {
+  const auto *bytes = reinterpret_cast<const unsigned char *>(&header);
+  uint64_t hash = 0xcbf29ce484222325;
+  for (std::size_t i = 0; i < offsetof(GraphFileHeader, checksum); i++) {
+    hash ^= bytes[i];
+    hash *= 0x100000001b3;
+  }
+  return hash;
+}
+
+// Byte size of every section of a graph with num_nodes and num_edges.
+static void section_sizes(uint64_t num_nodes, uint64_t num_edges,
+    uint64_t sizes[NUM_GRAPH_FILE_SECTIONS]
+) {
+  sizes[PUSH_INDEX]     = (num_nodes + 1) * sizeof(offset_t);
+  sizes[PUSH_NEIGHBORS] = num_edges * sizeof(nid_t);
+  sizes[PULL_INDEX]     = (num_nodes + 1) * sizeof(offset_t);
+  sizes[PULL_NEIGHBORS] = num_edges * sizeof(nid_t);
+  sizes[ORIGINAL_IDS]   = num_nodes * sizeof(nid_t);
+}
+
+static uint64_t align_up(uint64_t n) {
+  return (n + GRAPH_FILE_ALIGN - 1) / GRAPH_FILE_ALIGN * GRAPH_FILE_ALIGN;
+}
+
+bool write_graph_file(const std::string &path, const PushGraph &pushG,
+    const PullGraph &pullG, const nid_vec_t &original_ids
+) {
+  GraphFileHeader header = {};
+  header.magic     = GRAPH_FILE_MAGIC;
+  header.version   = GRAPH_FILE_VERSION;
+  header.num_nodes = pushG.num_nodes;
+  header.num_edges = pushG.num_edges;
+
+  uint64_t sizes[NUM_GRAPH_FILE_SECTIONS];
+  section_sizes(header.num_nodes, header.num_edges, sizes);
+  uint64_t offset = align_up(sizeof(header));
+  for (int s = 0; s < NUM_GRAPH_FILE_SECTIONS; s++) {
+    header.offsets[s] = offset;
+    offset = align_up(offset + sizes[s]);
+  }
+  header.checksum = header_checksum(header);
+
+  const void *data[NUM_GRAPH_FILE_SECTIONS] = {
+    pushG.index.data(), pushG.neighbors.data(),
+    pullG.index.data(), pullG.neighbors.data(), original_ids.data()};
+
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  if (not out) {
+    std::cerr << "[error] cannot open " << path << " for writing" << std::endl;
+    return false;
+  }
+  const char padding[GRAPH_FILE_ALIGN] = {};
+  out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  uint64_t pos = sizeof(header);
+  for (int s = 0; s < NUM_GRAPH_FILE_SECTIONS; s++) {
+    out.write(padding, header.offsets[s] - pos);
+    out.write(static_cast<const char *>(data[s]), sizes[s]);
+    pos = header.offsets[s] + sizes[s];
+  }
+  if (not out) {
+    std::cerr << "[error] failed writing " << path << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool is_graph_file(const std::string &path) {
+  uint32_t magic = 0;
+  std::ifstream in(path, std::ios::binary);
+  in.read(reinterpret_cast<char *>(&magic), sizeof(magic));
+  return in and magic == GRAPH_FILE_MAGIC;
+}
+
+bool GraphFile::open(const std::string &path) {
+  close();
+
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd == -1) {
+    std::cerr << "[error] cannot open " << path << std::endl;
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) == -1 or
+      static_cast<std::size_t>(st.st_size) < sizeof(GraphFileHeader)) {
+    std::cerr << "[error] " << path << " is not a graph file" << std::endl;
+    ::close(fd);
+    return false;
+  }
+  size_ = st.st_size;
+  // Private and writable so the views can back non-const tapa::mmaps; pages
+  // are only copied if written to.
+  addr_ = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (addr_ == MAP_FAILED) {
+    std::cerr << "[error] cannot mmap " << path << std::endl;
+    addr_ = nullptr;
+    return false;
+  }
+
+  const auto &header = *static_cast<const GraphFileHeader *>(addr_);
+  const char *error = nullptr;
+  uint64_t sizes[NUM_GRAPH_FILE_SECTIONS];
+  section_sizes(header.num_nodes, header.num_edges, sizes);
+  if (header.magic != GRAPH_FILE_MAGIC) {
+    error = "bad magic";
+  } else if (header.version != GRAPH_FILE_VERSION) {
+    error = "unsupported version";
+  } else if (header.checksum != header_checksum(header)) {
+    error = "header checksum mismatch";
+  } else {
+    for (int s = 0; s < NUM_GRAPH_FILE_SECTIONS; s++) {
+      if (header.offsets[s] % GRAPH_FILE_ALIGN != 0 or
+          header.offsets[s] + sizes[s] > size_)
+        error = "truncated or corrupted section";
+    }
+  }
+  if (error) {
+    std::cerr << "[error] " << path << ": " << error << std::endl;
+    close();
+    return false;
+  }
+
+  auto section = [this, &header](int s) {
+    return static_cast<char *>(addr_) + header.offsets[s];
+  };
+  push_.index     = {reinterpret_cast<offset_t *>(section(PUSH_INDEX)),
+                     header.num_nodes + 1};
+  push_.neighbors = {reinterpret_cast<nid_t *>(section(PUSH_NEIGHBORS)),
+                     header.num_edges};
+  pull_.index     = {reinterpret_cast<offset_t *>(section(PULL_INDEX)),
+                     header.num_nodes + 1};
+  pull_.neighbors = {reinterpret_cast<nid_t *>(section(PULL_NEIGHBORS)),
+                     header.num_edges};
+  push_.num_nodes = pull_.num_nodes = header.num_nodes;
+  push_.num_edges = pull_.num_edges = header.num_edges;
+  original_ids_   = {reinterpret_cast<nid_t *>(section(ORIGINAL_IDS)),
+                     header.num_nodes};
+  return true;
+}
+
+void GraphFile::close() {
+  if (addr_) munmap(addr_, size_);
+  addr_ = nullptr;
+  size_ = 0;
+  push_ = pull_ = GraphView();
+  original_ids_ = ArrayView<nid_t>();
+}
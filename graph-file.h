@@ -0,0 +1,76 @@
+#ifndef GRAPH_FILE_H
+#define GRAPH_FILE_H
+
+#include <cstdint>
+#include <string>
+
+#include "graph.h"
+
+/*
+ * Binary graph file (little endian):
+ *   GraphFileHeader
+ *   push index     (num_nodes + 1 offset_t)
+ *   push neighbors (num_edges nid_t)
+ *   pull index     (num_nodes + 1 offset_t)
+ *   pull neighbors (num_edges nid_t)
+ *   original IDs   (num_nodes nid_t)
+ * Every section starts at a GRAPH_FILE_ALIGN byte boundary so it can be
+ * mapped and used in place.
+ */
+constexpr uint32_t GRAPH_FILE_MAGIC   = 0x47534642; // "BFSG"
+constexpr uint32_t GRAPH_FILE_VERSION = 1;
+constexpr uint64_t GRAPH_FILE_ALIGN   = 64;
+
+enum GraphFileSection {
+  PUSH_INDEX, PUSH_NEIGHBORS, PULL_INDEX, PULL_NEIGHBORS, ORIGINAL_IDS,
+  NUM_GRAPH_FILE_SECTIONS
+};
+
+struct GraphFileHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t num_nodes;
+  uint64_t num_edges;
+  uint64_t offsets[NUM_GRAPH_FILE_SECTIONS]; // Byte offset of each section.
+  uint64_t checksum; // FNV-1a of all the fields above.
+};
+
+/**
+ * Writes push and pull graphs and the rename table to a binary graph file.
+ * Returns false (and prints why) on error.
+ */
+bool write_graph_file(const std::string &path, const PushGraph &pushG,
+    const PullGraph &pullG, const nid_vec_t &original_ids);
+
+// Whether path starts with the binary graph file magic.
+bool is_graph_file(const std::string &path);
+
+/**
+ * Binary graph file mapped in memory. The views point straight into the
+ * mapping (private, so writes through them never reach the file) and stay
+ * valid until the GraphFile is closed or destroyed.
+ */
+class GraphFile {
+ public:
+  GraphFile() = default;
+  GraphFile(const GraphFile &) = delete;
+  GraphFile &operator=(const GraphFile &) = delete;
+  ~GraphFile() { close(); }
+
+  // Maps the file at path. Returns false (and prints why) on error.
+  bool open(const std::string &path);
+  void close();
+
+  GraphView push() const { return push_; }
+  GraphView pull() const { return pull_; }
+  ArrayView<nid_t> original_ids() const { return original_ids_; }
+
+ private:
+  void       *addr_ = nullptr;
+  std::size_t size_ = 0;
+  GraphView        push_;
+  GraphView        pull_;
+  ArrayView<nid_t> original_ids_;
+};
+
+#endif // GRAPH_FILE_H
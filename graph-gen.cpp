@@ -0,0 +1,123 @@
+#include "graph-gen.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <numeric>
+#include <random>
+#include <thread>
+
+// Edges generated per thread at least (smaller graphs use fewer threads).
+constexpr std::size_t MIN_EDGES_PER_THREAD = 1 << 16;
+
+bool parse_graph_spec(const std::string &spec, GraphSpec *graph_spec) {
+  auto first = spec.find(':');
+  if (first == std::string::npos) return false;
+  std::string name = spec.substr(0, first);
+  if      (name == "uniform")   graph_spec->generator = Generator::uniform;
+  else if (name == "rmat")      graph_spec->generator = Generator::rmat;
+  else if (name == "kronecker") graph_spec->generator = Generator::kronecker;
+  else return false;
+
+  int scale, edge_factor;
+  char tail;
+  if (sscanf(spec.c_str() + first, ":%d:%d%c", &scale, &edge_factor,
+             &tail) != 2)
+    return false;
+  // Nodes and edges must fit in (signed 32-bit) nid_t and offset_t.
+  if (scale < 1 or scale > 30 or edge_factor < 1
+      or (int64_t(edge_factor) << scale) > INT32_MAX)
+    return false;
+  graph_spec->scale = scale;
+  graph_spec->edge_factor = edge_factor;
+  return true;
+}
+
+// SplitMix64 step: a counter-based generator, so any edge can be generated
+// without the ones before it.
+static uint64_t splitmix64(uint64_t &state) {
+  uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+// Uniform double in [0, 1) from the top 53 bits of a draw.
+static double unit(uint64_t &state) {
+  return (splitmix64(state) >> 11) * 0x1.0p-53;
+}
+
+// Edge i of a synthetic graph (node IDs before any scrambling).
+static edge_t make_edge(const GraphSpec &spec, uint64_t seed, offset_t i) {
+  // Decorrelate the streams of neighboring edges.
+  uint64_t state = seed ^ (uint64_t(i) * 0xd1342543de82ef95ULL);
+  splitmix64(state);
+  if (spec.generator == Generator::uniform) {
+    const uint64_t mask = (uint64_t(1) << spec.scale) - 1;
+    return {nid_t(splitmix64(state) & mask), nid_t(splitmix64(state) & mask)};
+  }
+
+  // Descend one quadrant per bit: a = (0, 0), b = (0, 1), c = (1, 0),
+  // d = (1, 1).
+  nid_t u = 0, v = 0;
+  for (int bit = spec.scale - 1; bit >= 0; bit--) {
+    double r = unit(state);
+    if (r < RMAT_A) {
+      // Top-left: neither bit set.
+    } else if (r < RMAT_A + RMAT_B) {
+      v |= nid_t(1) << bit;
+    } else if (r < RMAT_A + RMAT_B + RMAT_C) {
+      u |= nid_t(1) << bit;
+    } else {
+      u |= nid_t(1) << bit;
+      v |= nid_t(1) << bit;
+    }
+  }
+  return {u, v};
+}
+
+/**
+ * Generates the edge list of a synthetic graph.
+ * Parameters:
+ *   - spec        <- generator, scale and edge factor.
+ *   - seed        <- same seed, same graph.
+ *   - num_threads <- generator threads (0 = hardware concurrency).
+ */
+edge_list_t generate_edges(const GraphSpec &spec, uint64_t seed,
+    int num_threads
+) {
+  const nid_t    num_nodes = nid_t(1) << spec.scale;
+  const offset_t num_edges = offset_t(spec.edge_factor) << spec.scale;
+
+  if (num_threads <= 0)
+    num_threads = std::max(1u, std::thread::hardware_concurrency());
+  num_threads = std::max<std::size_t>(1,
+      std::min<std::size_t>(num_threads, num_edges / MIN_EDGES_PER_THREAD));
+
+  // Kronecker graphs scramble IDs so that degree does not follow the ID.
+  nid_vec_t permutation;
+  if (spec.generator == Generator::kronecker) {
+    permutation.resize(num_nodes);
+    std::iota(permutation.begin(), permutation.end(), 0);
+    std::mt19937_64 rng(seed);
+    std::shuffle(permutation.begin(), permutation.end(), rng);
+  }
+
+  // Thread t fills edges [num_edges * t / n, num_edges * (t + 1) / n).
+  edge_list_t edge_list(num_edges);
+  auto fill = [&](int t) {
+    offset_t begin = int64_t(num_edges) * t / num_threads;
+    offset_t end   = int64_t(num_edges) * (t + 1) / num_threads;
+    for (offset_t i = begin; i < end; i++) {
+      edge_t edge = make_edge(spec, seed, i);
+      if (not permutation.empty())
+        edge = {permutation[edge.first], permutation[edge.second]};
+      edge_list[i] = edge;
+    }
+  };
+  std::vector<std::thread> threads;
+  for (int t = 1; t < num_threads; t++) threads.emplace_back(fill, t);
+  fill(0);
+  for (auto &thread : threads) thread.join();
+  return edge_list;
+}
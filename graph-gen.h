@@ -0,0 +1,44 @@
+#ifndef GRAPH_GEN_H
+#define GRAPH_GEN_H
+
+#include <cstdint>
+#include <string>
+
+#include "graph.h"
+
+// Synthetic graph generators (see generate_edges).
+enum class Generator { uniform, rmat, kronecker };
+
+// R-MAT quadrant probabilities (Graph500); the last one is 1 - a - b - c.
+constexpr double RMAT_A = 0.57;
+constexpr double RMAT_B = 0.19;
+constexpr double RMAT_C = 0.19;
+
+// Synthetic graph: generator, 2^scale nodes, edge_factor * 2^scale edges.
+struct GraphSpec {
+  Generator generator;
+  int       scale;
+  int       edge_factor;
+};
+
+/**
+ * Parses "<generator>:<scale>:<edge factor>", e.g. "rmat:20:16", with
+ * generator "uniform", "rmat" or "kronecker". Returns false if spec is not
+ * one (e.g., a file name) or the graph would not fit nid_t/offset_t.
+ */
+bool parse_graph_spec(const std::string &spec, GraphSpec *graph_spec);
+
+/**
+ * Generates the edge list of a synthetic graph:
+ *   - uniform   <- both endpoints uniformly random.
+ *   - rmat      <- recursive matrix (R-MAT) with RMAT_A/B/C; low IDs are
+ *                  the hubs.
+ *   - kronecker <- R-MAT with node IDs scrambled by a random permutation,
+ *                  as in the Graph500 Kronecker generator.
+ * Edge i only depends on seed and i, so the output is the same for any
+ * num_threads (0 = hardware concurrency).
+ */
+edge_list_t generate_edges(const GraphSpec &spec, uint64_t seed,
+    int num_threads = 0);
+
+#endif // GRAPH_GEN_H
@@ -1,136 +1,279 @@
 #include "graph.h"
 
-#include <unordered_map>
+#include <algorithm>
+#include <iostream>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * Parses the edges in [begin, end) of a memory-mapped edge list.
+ * Lines starting with '#' (SNAP headers) are skipped.
+ */
+static void parse_edgelist_chunk(const char *begin, const char *end,
+    edge_list_t &edge_list
+) {
+  // Rough guess of "u v\n" pairs to avoid regrowing too often.
+  edge_list.reserve((end - begin) / 8);
+
+  const char *p = begin;
+  nid_t values[2];
+  int   num_values = 0;
+  while (p < end) {
+    char c = *p;
+    if (c == '#') { // Comment, skip until end of line.
+      while (p < end and *p != '\n') p++;
+    } else if (c >= '0' and c <= '9') {
+      nid_t value = 0;
+      while (p < end and *p >= '0' and *p <= '9')
+        value = value * 10 + (*p++ - '0');
+      values[num_values++] = value;
+      if (num_values == 2) {
+        edge_list.push_back(std::make_pair(values[0], values[1]));
+        num_values = 0;
+      }
+    } else {
+      p++; // Whitespace or separator.
+    }
+  }
+}
 
 /**
- * Loads in edge list from input stream.
+ * Loads in edge list from a file.
+ * The file is memory-mapped, split into newline-aligned chunks and each chunk
+ * is parsed by its own thread. Edges keep their order in the file.
+ * Parameters:
+ *   - path        <- edge list file (SNAP style, '#' comments allowed).
+ *   - num_threads <- number of parser threads (0 = hardware concurrency).
+ *   - file_size   <- (optional) number of bytes read.
  */
-edge_list_t load_edgelist(std::istream &in) {
+edge_list_t load_edgelist(const std::string &path, int num_threads,
+    std::size_t *file_size
+) {
   edge_list_t edge_list;
-  nid_t u, v;
-  
-  while (in >> u >> v)
-    edge_list.push_back(std::make_pair(u, v));
-  
+  if (file_size) *file_size = 0;
+
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    std::cerr << "[error] unable to open " << path << std::endl;
+    return edge_list;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 or st.st_size == 0) {
+    close(fd);
+    return edge_list;
+  }
+  std::size_t size = st.st_size;
+  void *addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED) {
+    std::cerr << "[error] unable to map " << path << std::endl;
+    return edge_list;
+  }
+  madvise(addr, size, MADV_SEQUENTIAL);
+  const char *data = static_cast<const char *>(addr);
+
+  if (num_threads <= 0)
+    num_threads = std::max(1u, std::thread::hardware_concurrency());
+  // Don't bother splitting small files.
+  constexpr std::size_t MIN_CHUNK_SIZE = 1 << 20;
+  num_threads = std::max<std::size_t>(1,
+      std::min<std::size_t>(num_threads, size / MIN_CHUNK_SIZE));
+
+  // Chunk boundaries, each (except the first) just past a newline.
+  std::vector<const char *> bounds(num_threads + 1);
+  bounds[0] = data;
+  bounds[num_threads] = data + size;
+  for (int i = 1; i < num_threads; i++) {
+    const char *p = std::max(bounds[i - 1], data + size / num_threads * i);
+    while (p < data + size and *(p - 1) != '\n') p++;
+    bounds[i] = p;
+  }
+
+  std::vector<edge_list_t> chunks(num_threads);
+  std::vector<std::thread> threads;
+  for (int i = 1; i < num_threads; i++)
+    threads.emplace_back(parse_edgelist_chunk, bounds[i], bounds[i + 1],
+        std::ref(chunks[i]));
+  parse_edgelist_chunk(bounds[0], bounds[1], chunks[0]);
+  for (auto &t : threads) t.join();
+
+  // Concatenate chunks in file order.
+  std::size_t num_edges = 0;
+  for (auto &chunk : chunks) num_edges += chunk.size();
+  edge_list = std::move(chunks[0]);
+  edge_list.reserve(num_edges);
+  for (int i = 1; i < num_threads; i++)
+    edge_list.insert(edge_list.end(), chunks[i].begin(), chunks[i].end());
+
+  munmap(addr, size);
+  if (file_size) *file_size = size;
   return edge_list;
 }
 
 /**
  * Constructs CSR and CSC graphs from an edge list.
  * Parmeters:
- *   - edge_list <- graph edge list (remap edge list too).
- *   - pushG     <- pointer to push graph.
- *   - pullG     <- pointer to pull graph.
+ *   - edge_list    <- graph edge list (remap edge list too).
+ *   - pushG        <- pointer to push graph.
+ *   - pullG        <- pointer to pull graph.
+ *   - original_ids <- if not null, original ID of every renamed node.
  */
 void build_graphs(edge_list_t &edge_list, 
-    PushGraph * const pushG, PullGraph * const pullG
+    PushGraph * const pushG, PullGraph * const pullG,
+    nid_vec_t * const original_ids
 ) {
-  // Determine neighbors and remap nodes.
-  std::unordered_map<nid_t, nid_t> node_rename;
-  std::unordered_map<nid_t, std::vector<nid_t>> node_to_children;
-  std::unordered_map<nid_t, std::vector<nid_t>> node_to_parents;
+  offset_t num_edges = edge_list.size();
+
+  // Map raw IDs to a compact range [0, num_ids). Dense IDs index a table
+  // directly; sparse IDs are ranked through a sorted list of unique IDs.
+  nid_t max_id = -1;
+  for (auto &edge : edge_list)
+    max_id = std::max({max_id, edge.first, edge.second});
+
+  std::vector<nid_t> unique_ids;
+  nid_t num_ids = max_id + 1;
+  if (static_cast<std::size_t>(num_ids) > 2 * edge_list.size()) {
+    unique_ids.reserve(2 * edge_list.size());
+    for (auto &edge : edge_list) {
+      unique_ids.push_back(edge.first);
+      unique_ids.push_back(edge.second);
+    }
+    std::sort(unique_ids.begin(), unique_ids.end());
+    unique_ids.erase(std::unique(unique_ids.begin(), unique_ids.end()),
+                     unique_ids.end());
+    unique_ids.shrink_to_fit();
+    num_ids = unique_ids.size();
+  }
+  auto compact_id = [&unique_ids](nid_t id) -> nid_t {
+    if (unique_ids.empty()) return id;
+    return std::lower_bound(unique_ids.begin(), unique_ids.end(), id)
+           - unique_ids.begin();
+  };
+
+  // Rename nodes in first-seen order and remap edge list.
   nid_t rename_id = 0;
-  offset_t num_edges = 0;
-  for (auto &edge : edge_list) {
-    if (not node_rename.count(edge.first))
-      node_rename[edge.first] = rename_id++;
-    if (not node_rename.count(edge.second))
-      node_rename[edge.second] = rename_id++;
-
-    // Remap edge.
-    edge.first = node_rename[edge.first];
-    edge.second = node_rename[edge.second];
-
-    // Push renamed edges to the appropriate neighbors list.
-    node_to_children[edge.first].push_back(edge.second);
-    node_to_parents[edge.second].push_back(edge.first);
-    num_edges++;
+  if (original_ids) original_ids->clear();
+  {
+    std::vector<nid_t> node_rename(num_ids, -1);
+    auto rename_node = [&](nid_t id) {
+      nid_t &u = node_rename[compact_id(id)];
+      if (u == -1) {
+        u = rename_id++;
+        if (original_ids) original_ids->push_back(id);
+      }
+      return u;
+    };
+    for (auto &edge : edge_list) {
+      nid_t u = rename_node(edge.first);
+      nid_t v = rename_node(edge.second);
+
+      edge.first = u;
+      edge.second = v;
+    }
   }
+  std::vector<nid_t>().swap(unique_ids);
 
   // Generate CSC and CSR graphs.
-  pushG->index = std::vector<offset_t>(rename_id + 1);
+  pushG->index = std::vector<offset_t>(rename_id + 1, 0);
   pushG->neighbors = std::vector<nid_t>(num_edges);
-  pullG->index = std::vector<offset_t>(rename_id + 1);
+  pullG->index = std::vector<offset_t>(rename_id + 1, 0);
   pullG->neighbors = std::vector<nid_t>(num_edges);
 
   pushG->num_nodes = pullG->num_nodes = rename_id;
   pushG->num_edges = pullG->num_edges = num_edges;
-  pushG->index[0] = pullG->index[0] = 0;
 
+  // Degree histograms (shifted by one) and prefix sums.
+  for (auto &edge : edge_list) {
+    pushG->index[edge.first + 1]++;
+    pullG->index[edge.second + 1]++;
+  }
   for (nid_t u = 0; u < rename_id; u++) {
-    // CSR (push)
-    {
-      auto neighbors = node_to_children[u];
-      pushG->index[u + 1] = pushG->index[u] + neighbors.size();
-      for (offset_t off = 0; off < neighbors.size(); off++)
-        pushG->neighbors[pushG->index[u] + off] = neighbors[off];
-    }
+    pushG->index[u + 1] += pushG->index[u];
+    pullG->index[u + 1] += pullG->index[u];
+  }
 
-    // CSC (pull)
-    {
-      auto neighbors = node_to_parents[u];
-      pullG->index[u + 1] = pullG->index[u] + neighbors.size();
-      for (offset_t off = 0; off < neighbors.size(); off++)
-        pullG->neighbors[pullG->index[u] + off] = neighbors[off];
-    }
+  // Stable scatter: neighbors keep their edge list order. index[u] is used
+  // as the insertion cursor and ends up at index[u + 1], so shift it back.
+  for (auto &edge : edge_list) {
+    pushG->neighbors[pushG->index[edge.first]++] = edge.second;
+    pullG->neighbors[pullG->index[edge.second]++] = edge.first;
+  }
+  for (nid_t u = rename_id; u > 0; u--) {
+    pushG->index[u] = pushG->index[u - 1];
+    pullG->index[u] = pullG->index[u - 1];
   }
+  pushG->index[0] = pullG->index[0] = 0;
 }
 
+/**
+ * Splits a push graph into num_partitions contiguous, edge-balanced node
+ * ranges.
+ * Returns (index_es, neighbors_es, num_nodes) where partition i owns nodes
+ * [num_nodes[i], num_nodes[i + 1]) and local node l = u - num_nodes[i] has
+ * neighbors neighbors_es[i][index_es[i][l] .. index_es[i][l + 1]).
+ * Neighbor IDs stay global.
+ */
 std::tuple<std::vector<offset_vec_t>, std::vector<nid_vec_t>, std::vector<nid_t>>
-partition_edges(PushGraph * const g, int num_partitions) {
-  offset_t avg_edges = (g->num_edges + num_partitions - 1) / num_partitions;
-
-  std::vector<nid_t> partition_nodes(num_partitions);
-  nid_t    cur_node       = 0;
-  offset_t cur_edges      = 0;
-  offset_t expected_edges = avg_edges;
-
-  for (int i = 0; i < num_partitions; i++) {
-    while (cur_node < g->num_nodes) {
-      offset_t new_edges = cur_edges + 
-                           (g->index[cur_node + 1] - g->index[cur_node]);
-
-      bool done = false;
-      if (new_edges >= expected_edges) {
-        if (new_edges - expected_edges < expected_edges - cur_edges)
-          partition_nodes[i] = ++cur_node;
-        else
-          partition_nodes[i] = cur_node;
-        done = true;
-      }
-
+partition_edges(const GraphView &g, int num_partitions) {
+  // Partition i ends at the node boundary closest to (i + 1) / n of edges.
+  std::vector<nid_t> num_nodes(num_partitions + 1);
+  num_nodes[0] = 0;
+  nid_t cur_node = 0;
+  for (int i = 1; i < num_partitions; i++) {
+    offset_t expected_edges = 
+      static_cast<int64_t>(g.num_edges) * i / num_partitions;
+    while (cur_node < g.num_nodes and g.index[cur_node + 1] <= expected_edges)
       cur_node++;
-      cur_edges = new_edges;
-
-      if (done) {
-        expected_edges += avg_edges;
-        break;
-      }
-    }
+    if (cur_node < g.num_nodes and 
+        g.index[cur_node + 1] - expected_edges 
+          < expected_edges - g.index[cur_node])
+      cur_node++;
+    num_nodes[i] = cur_node;
   }
-  partition_nodes.back() = g->num_nodes;
+  num_nodes[num_partitions] = g.num_nodes;
 
   std::vector<offset_vec_t> index_es(num_partitions);
   std::vector<nid_vec_t> neighbors_es(num_partitions);
-  nid_t start = 0;
   for (int i = 0; i < num_partitions; i++) {
-    nid_t end = partition_nodes[i];
+    nid_t    start = num_nodes[i];
+    nid_t    end   = num_nodes[i + 1];
+    offset_t base  = g.index[start];
 
-    for (nid_t u = start; u < end; u++) {
-      index_es[i].push_back(g->index[u]);
-      for (offset_t off = g->index[u]; off < g->index[u + 1]; off++) {
-        neighbors_es[i].push_back(g->neighbors[off]);
-      }
-    }
-    index_es[i].push_back(g->index[end]);
-
-    start = end;
+    index_es[i].reserve(end - start + 1);
+    for (nid_t u = start; u <= end; u++)
+      index_es[i].push_back(g.index[u] - base);
+    neighbors_es[i].assign(g.neighbors.begin() + base,
+                           g.neighbors.begin() + g.index[end]);
   }
 
-  std::vector<nid_t> num_nodes(num_partitions + 1);
-  num_nodes[0] = 0;
-  for (int i = 0; i < num_partitions; i++)
-    num_nodes[i + 1] = num_nodes[i] + index_es[i].size() - 1;
-
   return std::make_tuple(index_es, neighbors_es, num_nodes);
 }
+
+std::pair<std::vector<offset_vec_t>, std::vector<nid_vec_t>>
+shard_by_destination(const GraphView &g, int num_shards, int interval_bits) {
+  const nid_t mask = (nid_t(1) << interval_bits) - 1;
+  std::vector<offset_vec_t> index_ds(num_shards,
+                                     offset_vec_t(g.num_nodes + 1, 0));
+  std::vector<nid_vec_t> neighbors_ds(num_shards);
+
+  // Count the edges of every (shard, source) pair, then fill them in.
+  for (nid_t u = 0; u < g.num_nodes; u++)
+    for (offset_t off = g.index[u]; off < g.index[u + 1]; off++)
+      index_ds[g.neighbors[off] >> interval_bits][u + 1]++;
+  for (int i = 0; i < num_shards; i++) {
+    for (nid_t u = 0; u < g.num_nodes; u++)
+      index_ds[i][u + 1] += index_ds[i][u];
+    neighbors_ds[i].reserve(index_ds[i][g.num_nodes]);
+  }
+  for (nid_t u = 0; u < g.num_nodes; u++)
+    for (offset_t off = g.index[u]; off < g.index[u + 1]; off++) {
+      nid_t v = g.neighbors[off];
+      neighbors_ds[v >> interval_bits].push_back(v & mask);
+    }
+
+  return std::make_pair(index_ds, neighbors_ds);
+}
@@ -1,8 +1,9 @@
 #ifndef GRAPH_H
 #define GRAPH_H
 
+#include <cstddef>
 #include <cstdint>
-#include <istream>
+#include <string>
 #include <tuple>
 #include <vector>
 // For edge-centric
@@ -19,9 +20,9 @@ using nid_vec_t    = std::vector<nid_t>;
 using offset_vec_t = std::vector<offset_t>;
 
 // Base types for Edge-centric
-const int PARTITION_NUM = 2; //should be sizeof(BRAM)/sizeof(edge+vertex)
-const int MAX_EDGE = 2048;
-const int MAX_VER = 5000;
+const int PARTITION_NUM = 4; // Gather PEs, one destination interval each
+const int MAX_EDGE = 2048;   // edges per task (trip count hint)
+const int MAX_VER = 1 << 16; // vertices per destination interval (on-chip)
 template <typename T>
 using bits = ap_uint<tapa::widthof<T>()>;
 
@@ -31,24 +32,27 @@ using Pid = uint32_t;
 
 using VertexAttr = Vid;
 
-struct Edge {
-  Vid src;
-  Vid dst;
-};
-
 struct Update_edge_version {
   Vid dst;
   Vid depth;
+  Vid parent; // source the update came from (global ID)
 };
 struct Task{
-  Eid start_position;
-  Eid num_edges;
+  Vid src;
   VertexAttr depth;
 };
-using Resp = Vid;
-using Update_num = Vid;
+struct Resp { // vertex reached first, and its depth
+  Vid dst;
+  Vid depth;
+};
 // Invalid depth.
 constexpr depth_t INVALID_DEPTH = -1;
+// Invalid node (e.g., parent of an unreached node).
+constexpr nid_t INVALID_NODE = -1;
+
+// Multi-source BFS: bit i of a node's mask stands for source i of a batch.
+using source_mask_t = uint64_t;
+constexpr int MS_BATCH = 64; // Sources per batch (bits in source_mask_t).
 
 /**
  * Compressed graph format.
@@ -70,22 +74,75 @@ using PushGraph = CompressedGraph;
 using PullGraph = CompressedGraph;
 
 /**
- * Loads in edge list from input stream.
+ * Non-owning array (e.g., a section of a memory-mapped graph file).
+ * Elements are non-const so a view can back a tapa::mmap.
  */
-edge_list_t load_edgelist(std::istream &in);
+template <typename T>
+struct ArrayView {
+  T           *ptr = nullptr;
+  std::size_t len  = 0;
+
+  T &operator[](std::size_t i) const { return ptr[i]; }
+  T *data() const { return ptr; }
+  std::size_t size() const { return len; }
+  T *begin() const { return ptr; }
+  T *end() const { return ptr + len; }
+};
+
+/**
+ * Compressed graph that doesn't own its arrays. Converts implicitly from
+ * CompressedGraph, so code taking a GraphView runs on built and on
+ * memory-mapped graphs alike.
+ */
+struct GraphView {
+  ArrayView<offset_t> index;
+  ArrayView<nid_t>    neighbors;
+  nid_t               num_nodes = 0;
+  offset_t            num_edges = 0;
+
+  GraphView() = default;
+  GraphView(CompressedGraph &g)
+    : index{g.index.data(), g.index.size()},
+      neighbors{g.neighbors.data(), g.neighbors.size()},
+      num_nodes(g.num_nodes), num_edges(g.num_edges) {}
+};
+
+/**
+ * Loads in edge list from a file using num_threads parser threads
+ * (0 = hardware concurrency). Number of bytes read is stored in file_size.
+ */
+edge_list_t load_edgelist(const std::string &path, int num_threads = 0,
+    std::size_t *file_size = nullptr);
 
 /**
  * Constructs CSR and CSC graphs from an edge list.
  * Parmeters:
- *   - edge_list <- graph edge list (remap edge list too).
- *   - pushG     <- pointer to push graph.
- *   - pullG     <- pointer to pull graph.
+ *   - edge_list    <- graph edge list (remap edge list too).
+ *   - pushG        <- pointer to push graph.
+ *   - pullG        <- pointer to pull graph.
+ *   - original_ids <- if not null, original ID of every renamed node.
  */
 void build_graphs(edge_list_t &edge_list, 
-    PushGraph * const pushG, PullGraph * const pullG);
+    PushGraph * const pushG, PullGraph * const pullG,
+    nid_vec_t * const original_ids = nullptr);
 
+/**
+ * Splits a push graph into num_partitions contiguous, edge-balanced node
+ * ranges. Returns (index_es, neighbors_es, num_nodes): partition i owns nodes
+ * [num_nodes[i], num_nodes[i + 1]) with local (rebased) index_es[i] and
+ * neighbors_es[i].
+ */
 std::tuple<std::vector<offset_vec_t>, std::vector<nid_vec_t>, std::vector<nid_t>>
-partition_edges(PushGraph * const g, int num_partitions);
+partition_edges(const GraphView &g, int num_partitions);
+
+/**
+ * Splits the edges of a push graph by destination into num_shards intervals
+ * of 2^interval_bits nodes (shard i gets the edges into [i << interval_bits,
+ * (i + 1) << interval_bits)). Returns (index_ds, neighbors_ds): shard i is a
+ * CSR over all num_nodes sources with local (rebased) destinations.
+ */
+std::pair<std::vector<offset_vec_t>, std::vector<nid_vec_t>>
+shard_by_destination(const GraphView &g, int num_shards, int interval_bits);
 
 // Sort functions.
 struct {
@@ -0,0 +1,52 @@
+#include "level-stats.h"
+
+#include <fstream>
+#include <iostream>
+
+#include "bfs-fpga.h"
+
+static const char *mode_name(uint64_t mode) {
+  return mode == Mode::push ? "push" : "pull";
+}
+
+std::size_t num_levels(const std::vector<LevelStats> &stats) {
+  std::size_t n = 0;
+  while (n < stats.size() and stats[n].frontier_nodes != 0) n++;
+  return n;
+}
+
+bool write_level_stats(const std::string &path,
+    const std::vector<LevelStats> &stats
+) {
+  std::ofstream out(path);
+  if (not out) {
+    std::cerr << "[error] cannot write " << path << std::endl;
+    return false;
+  }
+
+  const std::size_t n = num_levels(stats);
+  const bool is_json =
+    path.size() >= 5 and path.compare(path.size() - 5, 5, ".json") == 0;
+  if (is_json) {
+    out << "[" << std::endl;
+    for (std::size_t i = 0; i < n; i++) {
+      const auto &s = stats[i];
+      out << "  {\"level\": " << i
+          << ", \"mode\": \"" << mode_name(s.mode) << "\""
+          << ", \"frontier_nodes\": " << s.frontier_nodes
+          << ", \"edges\": " << s.edges
+          << ", \"updates\": " << s.updates
+          << ", \"cycles\": " << s.cycles << "}"
+          << (i + 1 < n ? "," : "") << std::endl;
+    }
+    out << "]" << std::endl;
+  } else {
+    out << "level,mode,frontier_nodes,edges,updates,cycles" << std::endl;
+    for (std::size_t i = 0; i < n; i++) {
+      const auto &s = stats[i];
+      out << i << "," << mode_name(s.mode) << "," << s.frontier_nodes << ","
+          << s.edges << "," << s.updates << "," << s.cycles << std::endl;
+    }
+  }
+  return bool(out);
+}
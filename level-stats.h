@@ -0,0 +1,34 @@
+#ifndef LEVEL_STATS_H
+#define LEVEL_STATS_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Performance counters of one BFS level. Kernels write the record of
+ * level i to level_stats[i] of an extra mmap (as bits<LevelStats>); the
+ * setup of the start node is not a level. The records end at an all-zero
+ * entry written after the last level run (a kernel may stop before the
+ * BFS does, e.g. bfs_switch_levels), so the records of an earlier, deeper
+ * run in the same buffer are not counted.
+ */
+struct LevelStats {
+  uint64_t frontier_nodes; // Frontier size.
+  uint64_t edges;          // Edges traversed.
+  uint64_t updates;        // Depth updates emitted.
+  uint64_t mode;           // Direction (Mode).
+  uint64_t cycles;         // Estimated cycles (pipelined loop iterations).
+};
+
+// Number of levels run (records before the first empty frontier).
+std::size_t num_levels(const std::vector<LevelStats> &stats);
+
+/**
+ * Writes the records of the levels run to path, as JSON if path ends in
+ * ".json" and as CSV otherwise. Returns false (and prints why) on error.
+ */
+bool write_level_stats(const std::string &path,
+    const std::vector<LevelStats> &stats);
+
+#endif // LEVEL_STATS_H
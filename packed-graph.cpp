@@ -0,0 +1,64 @@
+#include "packed-graph.h"
+
+#include <algorithm>
+
+// Number of bits needed to hold delta.
+static int bit_width(uint32_t delta) {
+  return delta == 0 ? 0 : 32 - __builtin_clz(delta);
+}
+
+/**
+ * Packs the neighbor lists of g (see packed-graph.h for the format).
+ * Parameters:
+ *   - g <- push or pull graph.
+ */
+PackedGraph pack_graph(const GraphView &g) {
+  PackedGraph packed;
+  packed.num_nodes = g.num_nodes;
+  packed.num_edges = g.num_edges;
+  packed.index.resize(g.num_nodes + 1);
+  packed.words.reserve(g.num_edges / 2 + g.num_nodes);
+
+  std::vector<nid_t>    list;
+  std::vector<uint32_t> deltas;
+  for (nid_t u = 0; u < g.num_nodes; u++) {
+    packed.index[u] = packed.words.size();
+
+    list.assign(g.neighbors.begin() + g.index[u],
+                g.neighbors.begin() + g.index[u + 1]);
+    std::sort(list.begin(), list.end());
+    deltas.resize(list.size());
+    for (std::size_t i = 0; i < list.size(); i++) {
+      if (i == 0) { // Zigzag encode (the first neighbor may precede u).
+        int64_t d = int64_t(list[0]) - u;
+        deltas[i] = d < 0 ? uint32_t(-d) * 2 - 1 : uint32_t(d) * 2;
+      } else {
+        deltas[i] = list[i] - list[i - 1];
+      }
+    }
+
+    for (std::size_t b = 0; b < deltas.size(); b += PACK_BLOCK) {
+      int count = std::min<std::size_t>(PACK_BLOCK, deltas.size() - b);
+      int width = 0;
+      for (int i = 0; i < count; i++)
+        width = std::max(width, bit_width(deltas[b + i]));
+      packed.words.push_back(width | (count - 1) << 6);
+
+      uint64_t buffer = 0;
+      int      bits   = 0;
+      for (int i = 0; i < count; i++) {
+        buffer |= uint64_t(deltas[b + i]) << bits;
+        bits   += width;
+        if (bits >= PACK_WORD_BITS) {
+          packed.words.push_back(buffer);
+          buffer >>= PACK_WORD_BITS;
+          bits    -= PACK_WORD_BITS;
+        }
+      }
+      if (bits > 0) packed.words.push_back(buffer);
+    }
+  }
+  packed.index[g.num_nodes] = packed.words.size();
+  packed.words.shrink_to_fit();
+  return packed;
+}
@@ -0,0 +1,79 @@
+#ifndef PACKED_GRAPH_H
+#define PACKED_GRAPH_H
+
+#include <cstdint>
+#include <vector>
+
+#include "graph.h"
+
+/*
+ * Packed neighbor lists. Each node's neighbors are sorted and delta encoded
+ * (the first one relative to the node itself, zigzag encoded), then split
+ * into blocks of up to PACK_BLOCK deltas. A block is one header word
+ * (bits [0, 6): width, bits [6, 10): count - 1) followed by the deltas
+ * packed LSB first at width bits each into ceil(count * width / 32) words.
+ * Fixed-width blocks decode one neighbor per cycle in HLS.
+ */
+using pack_word_t = uint32_t;
+
+constexpr int PACK_WORD_BITS = 32;
+constexpr int PACK_BLOCK     = 16;
+
+struct PackedGraph {
+  offset_vec_t             index; // Word offset of each node's list.
+  std::vector<pack_word_t> words; // Packed neighbor lists.
+  nid_t                    num_nodes;
+  offset_t                 num_edges;
+
+  // Bytes read by a traversal (index and lists).
+  std::size_t bytes() const {
+    return index.size() * sizeof(offset_t) + words.size() * sizeof(pack_word_t);
+  }
+};
+
+// Packs the neighbor lists of g.
+PackedGraph pack_graph(const GraphView &g);
+
+/**
+ * Calls fn(v) for every neighbor v of node u in ascending order.
+ * Parameters:
+ *   - words      <- packed lists (a vector on CPU, a tapa::mmap in HLS).
+ *   - begin, end <- word range of u's list (index[u], index[u + 1]).
+ */
+template <typename Words, typename Fn>
+inline
+void unpack_neighbors(Words &words, offset_t begin, offset_t end, nid_t u,
+    Fn fn
+) {
+  uint32_t prev  = u;
+  bool     first = true;
+  for (offset_t w = begin; w < end;) {
+#pragma HLS loop_tripcount max=64
+    pack_word_t header = words[w++];
+    int width = header & 63;
+    int count = ((header >> 6) & (PACK_BLOCK - 1)) + 1;
+
+    uint64_t buffer = 0; // Bits not decoded yet, LSB first.
+    int      bits   = 0;
+    unpack_block:
+    for (int i = 0; i < count; i++) {
+#pragma HLS pipeline II=1
+      if (bits < width) {
+        buffer |= uint64_t(words[w++]) << bits;
+        bits   += PACK_WORD_BITS;
+      }
+      uint32_t delta = buffer & ((uint64_t(1) << width) - 1);
+      buffer >>= width;
+      bits    -= width;
+      if (first) { // Zigzag decode.
+        prev += (delta >> 1) ^ -(delta & 1);
+        first = false;
+      } else {
+        prev += delta;
+      }
+      fn(nid_t(prev));
+    }
+  }
+}
+
+#endif // PACKED_GRAPH_H
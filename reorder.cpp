@@ -0,0 +1,208 @@
+#include "reorder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <queue>
+#include <utility>
+
+// Nodes placed recently that a Gorder-lite candidate is scored against.
+constexpr nid_t GORDER_WINDOW = 8;
+
+bool parse_ordering(const std::string &name, Ordering *ordering) {
+  if      (name == "none")   *ordering = Ordering::none;
+  else if (name == "degree") *ordering = Ordering::degree;
+  else if (name == "rcm")    *ordering = Ordering::rcm;
+  else if (name == "gorder") *ordering = Ordering::gorder;
+  else return false;
+  return true;
+}
+
+// Total (in + out) degree of u.
+static offset_t degree(const GraphView &push_g, const GraphView &pull_g,
+    nid_t u
+) {
+  return push_g.index[u + 1] - push_g.index[u]
+         + pull_g.index[u + 1] - pull_g.index[u];
+}
+
+// Calls fn(v) for every undirected neighbor v of u.
+template <typename Fn>
+static void for_each_neighbor(const GraphView &push_g, const GraphView &pull_g,
+    nid_t u, Fn fn
+) {
+  for (offset_t off = push_g.index[u]; off < push_g.index[u + 1]; off++)
+    fn(push_g.neighbors[off]);
+  for (offset_t off = pull_g.index[u]; off < pull_g.index[u + 1]; off++)
+    fn(pull_g.neighbors[off]);
+}
+
+// Old IDs in descending degree order (ties keep their old order).
+static nid_vec_t by_degree(const GraphView &push_g, const GraphView &pull_g) {
+  nid_vec_t order(push_g.num_nodes);
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&](nid_t a, nid_t b) {
+    return degree(push_g, pull_g, a) > degree(push_g, pull_g, b);
+  });
+  return order;
+}
+
+// Old IDs in reverse Cuthill-McKee order.
+static nid_vec_t by_rcm(const GraphView &push_g, const GraphView &pull_g) {
+  const nid_t num_nodes = push_g.num_nodes;
+  nid_vec_t order;
+  order.reserve(num_nodes);
+  std::vector<bool> visited(num_nodes, false);
+  nid_vec_t children;
+
+  // Every component starts from its lowest degree node.
+  nid_vec_t roots = by_degree(push_g, pull_g);
+  std::reverse(roots.begin(), roots.end());
+  for (nid_t root : roots) {
+    if (visited[root]) continue;
+    visited[root] = true;
+    // order doubles as the BFS queue.
+    std::size_t head = order.size();
+    order.push_back(root);
+    for (; head < order.size(); head++) {
+      nid_t u = order[head];
+      children.clear();
+      for_each_neighbor(push_g, pull_g, u, [&](nid_t v) {
+        if (not visited[v]) {
+          visited[v] = true;
+          children.push_back(v);
+        }
+      });
+      std::stable_sort(children.begin(), children.end(), [&](nid_t a, nid_t b) {
+        return degree(push_g, pull_g, a) < degree(push_g, pull_g, b);
+      });
+      order.insert(order.end(), children.begin(), children.end());
+    }
+  }
+  std::reverse(order.begin(), order.end());
+  return order;
+}
+
+// Old IDs in Gorder-lite order.
+static nid_vec_t by_gorder(const GraphView &push_g, const GraphView &pull_g) {
+  const nid_t num_nodes = push_g.num_nodes;
+  nid_vec_t order;
+  order.reserve(num_nodes);
+  std::vector<bool> placed(num_nodes, false);
+  std::vector<nid_t> score(num_nodes, 0); // Edges into the window.
+  // Max-heap of (score, node); entries go stale as scores change and are
+  // skipped when popped.
+  std::priority_queue<std::pair<nid_t, nid_t>> candidates;
+
+  // Nodes without a scored candidate come in descending degree order.
+  nid_vec_t fallback = by_degree(push_g, pull_g);
+  std::size_t next_fallback = 0;
+
+  while (static_cast<nid_t>(order.size()) < num_nodes) {
+    nid_t u = -1;
+    while (not candidates.empty()) {
+      auto top = candidates.top();
+      candidates.pop();
+      if (not placed[top.second] and score[top.second] == top.first) {
+        u = top.second;
+        break;
+      }
+    }
+    if (u == -1) {
+      while (placed[fallback[next_fallback]]) next_fallback++;
+      u = fallback[next_fallback];
+    }
+    placed[u] = true;
+    order.push_back(u);
+
+    // u enters the window, the node placed GORDER_WINDOW steps ago leaves.
+    for_each_neighbor(push_g, pull_g, u, [&](nid_t v) {
+      if (placed[v]) return;
+      score[v]++;
+      candidates.emplace(score[v], v);
+    });
+    if (order.size() > static_cast<std::size_t>(GORDER_WINDOW)) {
+      nid_t w = order[order.size() - 1 - GORDER_WINDOW];
+      for_each_neighbor(push_g, pull_g, w, [&](nid_t v) {
+        if (placed[v]) return;
+        // Older entries of v are stale now; v stays a candidate while it
+        // still has edges into the window.
+        if (--score[v] > 0) candidates.emplace(score[v], v);
+      });
+    }
+  }
+  return order;
+}
+
+nid_vec_t compute_ordering(const GraphView &push_g, const GraphView &pull_g,
+    Ordering ordering
+) {
+  nid_vec_t order;
+  switch (ordering) {
+    case Ordering::degree: order = by_degree(push_g, pull_g); break;
+    case Ordering::rcm:    order = by_rcm(push_g, pull_g);    break;
+    case Ordering::gorder: order = by_gorder(push_g, pull_g); break;
+    case Ordering::none:
+      order.resize(push_g.num_nodes);
+      std::iota(order.begin(), order.end(), 0);
+      break;
+  }
+
+  nid_vec_t new_ids(push_g.num_nodes);
+  for (nid_t i = 0; i < push_g.num_nodes; i++) new_ids[order[i]] = i;
+  return new_ids;
+}
+
+CompressedGraph permute_graph(const GraphView &g, const nid_vec_t &new_ids) {
+  CompressedGraph permuted;
+  permuted.num_nodes = g.num_nodes;
+  permuted.num_edges = g.num_edges;
+  permuted.index.assign(g.num_nodes + 1, 0);
+  permuted.neighbors.resize(g.num_edges);
+
+  for (nid_t u = 0; u < g.num_nodes; u++)
+    permuted.index[new_ids[u] + 1] = g.index[u + 1] - g.index[u];
+  for (nid_t u = 0; u < g.num_nodes; u++)
+    permuted.index[u + 1] += permuted.index[u];
+
+  for (nid_t u = 0; u < g.num_nodes; u++) {
+    offset_t pos = permuted.index[new_ids[u]];
+    for (offset_t off = g.index[u]; off < g.index[u + 1]; off++)
+      permuted.neighbors[pos++] = new_ids[g.neighbors[off]];
+    std::sort(permuted.neighbors.begin() + permuted.index[new_ids[u]],
+              permuted.neighbors.begin() + pos);
+  }
+  return permuted;
+}
+
+nid_vec_t unpermute_parents(const nid_vec_t &parents,
+    const nid_vec_t &new_ids
+) {
+  nid_vec_t old_ids(new_ids.size());
+  for (nid_t u = 0; u < static_cast<nid_t>(new_ids.size()); u++)
+    old_ids[new_ids[u]] = u;
+  nid_vec_t old_parents = unpermute(parents, new_ids);
+  for (auto &parent : old_parents)
+    if (parent != INVALID_NODE) parent = old_ids[parent];
+  return old_parents;
+}
+
+LocalityStats locality_stats(const GraphView &g) {
+  constexpr nid_t LINE_NODES = 64 / sizeof(depth_t);
+  double   gap_bits     = 0;
+  offset_t line_changes = 0;
+  nid_vec_t list;
+  for (nid_t u = 0; u < g.num_nodes; u++) {
+    list.assign(g.neighbors.begin() + g.index[u],
+                g.neighbors.begin() + g.index[u + 1]);
+    std::sort(list.begin(), list.end());
+    nid_t prev = u;
+    for (nid_t v : list) {
+      gap_bits     += std::log2(1.0 + std::abs(double(v) - prev));
+      line_changes += v / LINE_NODES != prev / LINE_NODES;
+      prev = v;
+    }
+  }
+  double num_edges = std::max<offset_t>(g.num_edges, 1);
+  return {gap_bits / num_edges, line_changes / num_edges};
+}
@@ -0,0 +1,53 @@
+#ifndef REORDER_H
+#define REORDER_H
+
+#include <string>
+#include <vector>
+
+#include "graph.h"
+
+// Node orderings (see compute_ordering).
+enum class Ordering { none, degree, rcm, gorder };
+
+// Parses "none", "degree", "rcm" or "gorder". Returns false if unknown.
+bool parse_ordering(const std::string &name, Ordering *ordering);
+
+/**
+ * Computes a new ID for every node (new_ids[old] = new):
+ *   - degree <- by total degree, descending (hubs share cache lines).
+ *   - rcm    <- reverse Cuthill-McKee over the undirected graph.
+ *   - gorder <- greedy window ordering (Gorder-lite): the next node is the
+ *               one with the most edges into the last few placed nodes.
+ */
+nid_vec_t compute_ordering(const GraphView &push_g, const GraphView &pull_g,
+    Ordering ordering);
+
+// Renumbers g with new_ids; neighbor lists come out sorted.
+CompressedGraph permute_graph(const GraphView &g, const nid_vec_t &new_ids);
+
+// Maps per-node values of a renumbered graph back to the old IDs.
+template <typename T>
+std::vector<T> unpermute(const std::vector<T> &values,
+    const nid_vec_t &new_ids
+) {
+  std::vector<T> old_values(values.size());
+  for (nid_t u = 0; u < static_cast<nid_t>(new_ids.size()); u++)
+    old_values[u] = values[new_ids[u]];
+  return old_values;
+}
+
+// unpermute for node IDs (e.g., BFS parents): moves them to the old IDs
+// and renames them back as well. INVALID_NODE stays as is.
+nid_vec_t unpermute_parents(const nid_vec_t &parents,
+    const nid_vec_t &new_ids);
+
+struct LocalityStats {
+  double gap_bits;    // Mean log2 gap between consecutive sorted neighbors.
+  double line_change; // Fraction of neighbors in another 64 B depth line
+                      // than the previous neighbor of the same list.
+};
+
+// Locality of the neighbor accesses of g.
+LocalityStats locality_stats(const GraphView &g);
+
+#endif // REORDER_H
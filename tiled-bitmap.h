@@ -0,0 +1,119 @@
+#ifndef TILED_BITMAP_H
+#define TILED_BITMAP_H
+
+#include <tapa.h>
+
+#include "bitmap.h"
+#include "graph.h"
+
+namespace Bitmap {
+
+using tile_word_t = wide_bitmap_t;
+
+constexpr nid_t TILE_WORDS = 8;  // Bitmap words per tile.
+constexpr nid_t NUM_TILES  = 32; // Tiles cached on-chip.
+constexpr nid_t TILE_BITS  = TILE_WORDS * word_bits<tile_word_t>::value;
+
+// Number of spill words needed by a bitmap of num_bits (whole tiles).
+constexpr size_t spill_size(size_t num_bits) {
+  return (num_bits + TILE_BITS - 1) / TILE_BITS * TILE_WORDS;
+}
+
+/**
+ * Bitmap of arbitrary length. The whole bitmap lives in a DRAM spill buffer
+ * (spill[base, base + spill_size(num_bits))) and NUM_TILES tiles are cached
+ * on-chip (direct mapped, write-back). Bitmaps up to NUM_TILES * TILE_BITS
+ * bits never touch DRAM.
+ * The spill buffer is passed to every call because HLS can't store
+ * a tapa::mmap in a struct.
+ */
+struct TiledBitmap {
+  tile_word_t data[NUM_TILES][TILE_WORDS];
+  nid_t       tag[NUM_TILES];   // Tile held by each line.
+  bool        dirty[NUM_TILES]; // Line differs from spill.
+  size_t      base;
+  nid_t       num_tiles;
+
+  // Resets the bitmap to num_bits zeros.
+  void reset(tapa::mmap<tile_word_t> &spill, size_t spill_base,
+      size_t num_bits
+  ) {
+    base      = spill_base;
+    num_tiles = spill_size(num_bits) / TILE_WORDS;
+    for (nid_t line = 0; line < NUM_TILES; line++) {
+      tag[line]   = line;
+      dirty[line] = false;
+    }
+    clear(spill, 0, num_tiles * TILE_WORDS);
+  }
+
+  // Uses the bitmap of num_bits already in the spill buffer (e.g., filled
+  // by the host); tiles are loaded on first use.
+  void attach(size_t spill_base, size_t num_bits) {
+    base      = spill_base;
+    num_tiles = spill_size(num_bits) / TILE_WORDS;
+    for (nid_t line = 0; line < NUM_TILES; line++) {
+      tag[line]   = -1;
+      dirty[line] = false;
+    }
+  }
+
+  // Set words [first, first + num_words) to 0.
+  void clear(tapa::mmap<tile_word_t> &spill, size_t first, size_t num_words) {
+    for (size_t w = first; w < first + num_words; w++) {
+#pragma HLS pipeline II=1
+      nid_t tile = w / TILE_WORDS;
+      nid_t line = tile % NUM_TILES;
+      if (tag[line] == tile) {
+        data[line][w % TILE_WORDS] = 0;
+        dirty[line] = true;
+      } else {
+        spill[base + w] = 0;
+      }
+    }
+  }
+
+  // Returns the cache line holding word w, loading its tile if needed.
+  nid_t fetch(tapa::mmap<tile_word_t> &spill, size_t w) {
+    nid_t tile = w / TILE_WORDS;
+    nid_t line = tile % NUM_TILES;
+    if (tag[line] != tile) { // Miss.
+      if (dirty[line]) {
+        for (nid_t i = 0; i < TILE_WORDS; i++) {
+#pragma HLS pipeline II=1
+          spill[base + size_t(tag[line]) * TILE_WORDS + i] = data[line][i];
+        }
+      }
+      for (nid_t i = 0; i < TILE_WORDS; i++) {
+#pragma HLS pipeline II=1
+        data[line][i] = spill[base + size_t(tile) * TILE_WORDS + i];
+      }
+      tag[line]   = tile;
+      dirty[line] = false;
+    }
+    return line;
+  }
+
+  tile_word_t word(tapa::mmap<tile_word_t> &spill, size_t w) {
+    return data[fetch(spill, w)][w % TILE_WORDS];
+  }
+
+  bool get(tapa::mmap<tile_word_t> &spill, size_t n) {
+    size_t w = data_offset<tile_word_t>(n);
+    return get_bit(data[fetch(spill, w)],
+        (w % TILE_WORDS) * word_bits<tile_word_t>::value
+        + bit_offset<tile_word_t>(n));
+  }
+
+  void set(tapa::mmap<tile_word_t> &spill, size_t n) {
+    size_t w    = data_offset<tile_word_t>(n);
+    nid_t  line = fetch(spill, w);
+    set_bit(data[line], (w % TILE_WORDS) * word_bits<tile_word_t>::value
+                        + bit_offset<tile_word_t>(n));
+    dirty[line] = true;
+  }
+};
+
+} // namespace Bitmap
+
+#endif // TILED_BITMAP_H
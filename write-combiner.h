@@ -0,0 +1,109 @@
+#ifndef WRITE_COMBINER_H
+#define WRITE_COMBINER_H
+
+#include <cstdint>
+#include <tapa.h>
+
+#include "graph.h"
+
+constexpr int   WC_LINE_BYTES = 64; // One DRAM burst.
+constexpr nid_t WC_NUM_LINES  = 64; // Lines cached on-chip.
+
+/**
+ * Write-back line cache in front of scattered writes to mem (e.g., depth
+ * updates): writes land in on-chip lines of WC_LINE_BYTES (direct mapped)
+ * and leave as whole-line bursts, so nearby updates share one DRAM
+ * transaction instead of a read-modify-write each. A line is loaded before
+ * its first write (entries not written keep their values in mem).
+ * Only mem[0, size) is accessed. Call flush before anyone else reads mem.
+ * As with Bitmap::TiledBitmap, mem is passed to every call because HLS
+ * can't store a tapa::mmap in a struct.
+ */
+template <typename T>
+struct WriteCombiner {
+  static constexpr nid_t LINE_ENTRIES = WC_LINE_BYTES / sizeof(T);
+
+  T       data[WC_NUM_LINES][LINE_ENTRIES];
+  int64_t tag[WC_NUM_LINES];   // Line of mem held by each cache line.
+  bool    dirty[WC_NUM_LINES]; // Cache line differs from mem.
+  size_t  size;
+
+  // Empties the cache for writes to mem[0, mem_size).
+  void reset(size_t mem_size) {
+    size = mem_size;
+    for (nid_t line = 0; line < WC_NUM_LINES; line++) {
+#pragma HLS unroll
+      tag[line]   = -1;
+      dirty[line] = false;
+    }
+  }
+
+  void write(tapa::mmap<T> &mem, size_t i, T value) {
+    int64_t mem_line = i / LINE_ENTRIES;
+    nid_t   line     = mem_line % WC_NUM_LINES;
+    if (tag[line] != mem_line) { // Miss.
+      write_back(mem, line);
+      size_t first = size_t(mem_line) * LINE_ENTRIES;
+      load:
+      for (nid_t j = 0; j < LINE_ENTRIES and first + j < size; j++) {
+#pragma HLS pipeline II=1
+        data[line][j] = mem[first + j];
+      }
+      tag[line] = mem_line;
+    }
+    data[line][i % LINE_ENTRIES] = value;
+    dirty[line] = true;
+  }
+
+  // Writes every dirty line back to mem; lines stay cached.
+  void flush(tapa::mmap<T> &mem) {
+    for (nid_t line = 0; line < WC_NUM_LINES; line++)
+      write_back(mem, line);
+  }
+
+  // Writes cache line back to mem if dirty.
+  void write_back(tapa::mmap<T> &mem, nid_t line) {
+    if (not dirty[line]) return;
+    size_t first = size_t(tag[line]) * LINE_ENTRIES;
+    store:
+    for (nid_t j = 0; j < LINE_ENTRIES and first + j < size; j++) {
+#pragma HLS pipeline II=1
+      mem[first + j] = data[line][j];
+    }
+    dirty[line] = false;
+  }
+};
+
+/**
+ * Body of the depth writers: writes value(depth, update) to
+ * mem[base + update.node] for every update of an epoch on update_q (closed
+ * after each epoch) through a WriteCombiner flushed at the end of the
+ * epoch, then calls flushed() (e.g., to tell a controller the epoch is in
+ * mem). The first epoch has depth start_depth.
+ * Runs forever, or returns after the first empty epoch if until_empty
+ * (one session query). Only mem[0, size) is accessed.
+ */
+template <typename T, typename Update, typename Value, typename Flushed>
+void write_epochs(tapa::istream<Update> &update_q, tapa::mmap<T> &mem,
+    size_t base, size_t size, depth_t start_depth, bool until_empty,
+    Value value, Flushed flushed
+) {
+  WriteCombiner<T> lines;
+  lines.reset(size);
+  for (depth_t depth = start_depth;; depth++) {
+#pragma HLS loop_tripcount max=2048
+    bool is_empty = true;
+    TAPA_WHILE_NOT_EOT(update_q) {
+      auto update = update_q.read(nullptr);
+      lines.write(mem, base + update.node, value(depth, update));
+      is_empty = false;
+    }
+    update_q.try_open(); // Reset stream.
+    lines.flush(mem);
+    flushed();
+
+    if (until_empty and is_empty) return;
+  }
+}
+
+#endif // WRITE_COMBINER_H